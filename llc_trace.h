@@ -0,0 +1,50 @@
+#ifndef LLC_TRACE_H
+#define LLC_TRACE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// Recorded LLC access stream, replayed by replay.cc. A stream is one
+// LlcTraceHeader followed by LlcAccess records, fixed-size and in host
+// (little-endian) byte order. Streams are normally gzip-compressed.
+
+static const char LLC_TRACE_MAGIC[8] = { 'L', 'L', 'C', 'A', 'C', 'C', '1', '\0' };
+
+struct LlcTraceHeader {
+    char     magic[8];
+    uint32_t num_core;
+    uint32_t llc_sets;
+    uint32_t llc_ways;
+    uint32_t reserved;
+};
+
+// One LLC access (hit or fill) as seen by UpdateReplacementState
+struct LlcAccess {
+    uint64_t pc;
+    uint64_t paddr;
+    uint64_t instr;      // instructions retired by cpu at the access
+    uint32_t set;
+    uint8_t  cpu;
+    uint8_t  type;       // LOAD, RFO, PREFETCH, WRITEBACK
+    uint8_t  hit;        // outcome in the recording run
+    uint8_t  way;        // way hit or filled in the recording run
+};
+
+static_assert(sizeof(LlcTraceHeader) == 24, "LlcTraceHeader layout");
+static_assert(sizeof(LlcAccess) == 32, "LlcAccess layout");
+
+static inline bool llc_trace_magic_ok(const LlcTraceHeader &h) {
+    return memcmp(h.magic, LLC_TRACE_MAGIC, sizeof(LLC_TRACE_MAGIC)) == 0;
+}
+
+// Checkpoint hooks implemented by the policy for replay.cc. The policy
+// section of a checkpoint must start at a CKPT_PAGE_SIZE-aligned offset;
+// LoadReplacementState receives it mapped in memory and fails when the
+// running policy's parameters differ from the saved ones.
+static const size_t CKPT_PAGE_SIZE = 4096;
+
+bool SaveReplacementState(FILE *out);
+bool LoadReplacementState(const uint8_t *data, size_t size);
+
+#endif
@@ -1,52 +1,152 @@
 #include <vector>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include "../inc/champsim_crc2.h"
+#include "llc_trace.h"
 
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Default LLC geometry; overridden at runtime by load_config()
 #define NUM_CORE    1
 #define LLC_SETS    (NUM_CORE * 2048)
 #define LLC_WAYS    16
 
 // RRPV configuration (3 bits → values 0..7)
-static const int RRPV_BITS    = 3;
-static const int MAX_RRPV     = (1 << RRPV_BITS) - 1;
+static const int RRPV_BITS    = 3;            // default, runtime key rrpv_bits
 
 // SHiP configuration
-static const int SHCT_SIZE    = 1024;         // must be power of two
-static const int SHCT_MAX     = 7;            // 3-bit counter max
-static const int SHCT_INIT    = 4;            // initial counter value
-static const int THRESHOLD    = SHCT_INIT;    // reuse threshold
+static const int SHCT_SIZE    = 1024;         // default, must be power of two
+static const int SHCT_MAX     = 7;            // 3-bit counter max, runtime key shct_max
+static const int SHCT_INIT    = 4;            // initial counter value, key shct_init
+static const int THRESHOLD    = SHCT_INIT;    // reuse threshold, key threshold
 static const int SIGN_SHIFT   = 4;            // signature = (PC>>SHIFT) & (SHCT_SIZE-1)
 
-// Replacement state per block
-static uint8_t  repl_rrpv   [NUM_CORE][LLC_SETS][LLC_WAYS];
-static uint16_t repl_sig    [NUM_CORE][LLC_SETS][LLC_WAYS];  // PC signature index
-static uint8_t  repl_reused [NUM_CORE][LLC_SETS][LLC_WAYS];  // reuse bit
+// How cores share the SHCT (runtime key shct_mode). With a shared table,
+// cores running different binaries alias each other's PCs; the multi-core
+// modes hash the core ID into the signature or give each core its own bank.
+static const uint32_t SHCT_SHARED      = 0;
+static const uint32_t SHCT_CORE_HASH   = 1;
+static const uint32_t SHCT_CORE_BANKED = 2;
 
-// Global SHCT: per‐signature saturating counters
-static uint8_t  SHCT[SHCT_SIZE];
+// Runtime parameters. Start from the defaults above, then apply a
+// "key = value" file named by $SHIP_CONFIG, then $SHIP_<KEY> variables
+// (e.g. SHIP_LLC_SETS=32768), so one binary covers every sweep point.
+// llc_sets defaults to num_core * 2048 when only num_core is given.
+struct ShipConfig {
+    uint32_t num_core   = NUM_CORE;
+    uint32_t llc_sets   = 0;
+    uint32_t llc_ways   = LLC_WAYS;
+    uint32_t rrpv_bits  = RRPV_BITS;
+    uint32_t shct_size  = SHCT_SIZE;
+    uint32_t sign_shift = SIGN_SHIFT;
+    uint32_t shct_mode  = SHCT_SHARED;
+    uint32_t leader_sets = 0;                 // 0: every set trains the SHCT
+    uint32_t shct_max   = SHCT_MAX;
+    uint32_t shct_init  = SHCT_INIT;
+    uint32_t threshold  = THRESHOLD;
+    uint32_t wb_aware   = 0;                  // 1: writebacks bypass the SHCT
+    uint32_t pf_aware   = 0;                  // 1: separate prefetch signatures
+    uint32_t bypass     = 0;                  // 1: bypass fills predicted dead
+    uint32_t bypass_sample = 32;              // 1 in N predicted-dead fills still allocate
+};
+static ShipConfig cfg;
 
-// Statistics
-static uint64_t stat_hits;
-static uint64_t stat_misses;
+static const int MAX_WAYS     = 64;           // width of the reuse bitmask
+static const int CACHE_LINE   = 64;
 
-// Initialize replacement state
-void InitReplacementState() {
-    stat_hits   = 0;
-    stat_misses = 0;
-    // Initialize RRPVs, signatures, reuse bits
-    for (int c = 0; c < NUM_CORE; c++) {
-        for (int s = 0; s < LLC_SETS; s++) {
-            for (int w = 0; w < LLC_WAYS; w++) {
-                repl_rrpv[c][s][w]   = MAX_RRPV;
-                repl_sig[c][s][w]    = 0;
-                repl_reused[c][s][w] = 0;
-            }
+// CRC2 access types (LOAD, RFO, PREFETCH, WRITEBACK) for per-type statistics
+static const uint32_t ACCESS_TYPES = 4;
+static const char *access_type_names[ACCESS_TYPES] = {
+    "LOAD", "RFO", "PREFETCH", "WRITEBACK"
+};
+
+// Insertion decisions, from strongest to weakest predicted reuse: RRPV 0,
+// RRPV 1, max_rrpv - 1 and max_rrpv
+static const uint32_t INSERT_CLASSES = 4;
+static const char *insert_class_names[INSERT_CLASSES] = { "mru", "near", "far", "distant" };
+
+// Vector helpers over one set's RRPV bytes. SSE2 handles 16 ways per
+// instruction (AVX2 32 for aging) when the way count is a multiple of the
+// vector width; other targets and way counts use the scalar loops.
+
+// Lowest way holding the set's largest RRPV; that RRPV is stored in max_out.
+static inline uint32_t find_victim_way(const uint8_t *rrpv, uint32_t ways,
+                                       uint8_t &max_out) {
+#if defined(__SSE2__)
+    if (ways % 16 == 0) {
+        // Horizontal max over all chunks, then one compare for the lowest match
+        __m128i m = _mm_loadu_si128((const __m128i *)rrpv);
+        for (uint32_t w = 16; w < ways; w += 16) {
+            m = _mm_max_epu8(m, _mm_loadu_si128((const __m128i *)(rrpv + w)));
+        }
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 8));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+        max_out = (uint8_t)_mm_cvtsi128_si32(m);
+        const __m128i max_v = _mm_set1_epi8((char)max_out);
+        for (uint32_t w = 0; w < ways; w += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(rrpv + w));
+            uint32_t hit = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, max_v));
+            if (hit) return w + __builtin_ctz(hit);
+        }
+    }
+#endif
+    uint32_t victim = 0;
+    max_out = rrpv[0];
+    for (uint32_t w = 1; w < ways; w++) {
+        if (rrpv[w] > max_out) {
+            max_out = rrpv[w];
+            victim  = w;
         }
     }
-    // Initialize SHCT to mid‐value
-    for (int i = 0; i < SHCT_SIZE; i++) {
-        SHCT[i] = SHCT_INIT;
+    return victim;
+}
+
+// Age every way by delta, saturating at max_rrpv.
+static inline void age_rrpv(uint8_t *rrpv, uint32_t ways, uint8_t delta,
+                            uint8_t max_rrpv) {
+#if defined(__AVX2__)
+    if (ways % 32 == 0) {
+        const __m256i max_v = _mm256_set1_epi8((char)max_rrpv);
+        const __m256i d_v   = _mm256_set1_epi8((char)delta);
+        for (uint32_t w = 0; w < ways; w += 32) {
+            __m256i *p = (__m256i *)(rrpv + w);
+            __m256i v  = _mm256_loadu_si256(p);
+            _mm256_storeu_si256(p, _mm256_min_epu8(_mm256_adds_epu8(v, d_v), max_v));
+        }
+        return;
+    }
+#endif
+#if defined(__SSE2__)
+    if (ways % 16 == 0) {
+        const __m128i max_v = _mm_set1_epi8((char)max_rrpv);
+        const __m128i d_v   = _mm_set1_epi8((char)delta);
+        for (uint32_t w = 0; w < ways; w += 16) {
+            __m128i *p = (__m128i *)(rrpv + w);
+            __m128i v  = _mm_loadu_si128(p);
+            _mm_storeu_si128(p, _mm_min_epu8(_mm_adds_epu8(v, d_v), max_v));
+        }
+        return;
+    }
+#endif
+    for (uint32_t w = 0; w < ways; w++) {
+        rrpv[w] = (rrpv[w] + delta > max_rrpv) ? max_rrpv : rrpv[w] + delta;
     }
 }
 
@@ -58,41 +158,1257 @@ static inline void sat_dec(uint8_t &c) {
     if (c > 0) c--;
 }
 
-// SRRIP victim selection (with adaptive second-pass aging)
-uint32_t GetVictimInSet(
-    uint32_t         cpu,
-    uint32_t         set,
-    const BLOCK     *current_set,
-    uint64_t         PC,
-    uint64_t         paddr,
-    uint32_t         type
-) {
-    // First pass: try to find MAX_RRPV
-    for (int attempt = 0; attempt < 2; ++attempt) {
-        for (uint32_t w = 0; w < LLC_WAYS; w++) {
-            if (repl_rrpv[cpu][set][w] == MAX_RRPV) {
-                return w;
+// A contiguous piece of policy state, saved and restored verbatim
+typedef std::pair<void *, size_t> StateBlock;
+
+// Interface the CRC2 entry points dispatch through
+class ReplPolicy {
+  public:
+    // Statistics
+    uint64_t stat_hits   = 0;
+    uint64_t stat_misses = 0;
+    uint64_t stat_type_hits[ACCESS_TYPES]   = {};
+    uint64_t stat_type_misses[ACCESS_TYPES] = {};
+    uint64_t stat_type_insert[ACCESS_TYPES][INSERT_CLASSES] = {};
+    uint64_t stat_type_evictions[ACCESS_TYPES] = {};    // valid lines a fill displaced
+    uint64_t stat_bypasses = 0;
+
+    virtual ~ReplPolicy() {}
+    virtual bool     specialized() const = 0;
+    virtual void     print_storage() const = 0;
+    virtual const std::vector<uint8_t> &shct() const = 0;
+#ifdef SHIP_PRED_STATS
+    virtual void     print_prediction_stats() const = 0;
+#endif
+    virtual void     state_blocks(std::vector<StateBlock> &blocks) = 0;
+    virtual void     restored() = 0;
+    virtual uint32_t shct_index(uint32_t cpu, uint64_t PC, uint32_t type) const = 0;
+    virtual uint32_t victim(uint32_t cpu, uint32_t set, uint64_t PC,
+                            uint64_t paddr, uint32_t type) = 0;
+    virtual void     update(uint32_t cpu, uint32_t set, uint32_t way,
+                            uint64_t paddr, uint64_t PC, uint64_t victim_addr,
+                            uint32_t type, uint8_t hit) = 0;
+};
+
+// SHiP-RRIP+ core. Every non-zero template argument fixes that parameter at
+// compile time, so per-way loops get constant trip counts and the record
+// layout folds to constants; DYN reads the value from the runtime config.
+static const uint32_t DYN = 0;
+
+template <uint32_t WAYS, uint32_t BITS, uint32_t SHCT_N, uint32_t SHIFT>
+class ShipRrip : public ReplPolicy {
+  public:
+    explicit ShipRrip(const ShipConfig &c)
+        : cfg_(c), shct_(shct_entries(), (uint8_t)c.shct_init),
+          prefetched_(c.llc_sets, 0)
+#ifdef SHIP_PRED_STATS
+        , pred_lines_((size_t)c.llc_sets * ways()),
+          sig_evictions_(shct_entries(), 0), sig_correct_(shct_entries(), 0)
+#endif
+    {
+        // Allocate every set record (plus the leader training records when
+        // sampling) once, cache-line aligned. The LLC is shared, so there is
+        // one record per set regardless of core count.
+        leader_stride_ = 1;
+        num_trained_   = cfg_.llc_sets;
+        if (sampled() && cfg_.leader_sets < cfg_.llc_sets) {
+            leader_stride_ = cfg_.llc_sets / cfg_.leader_sets;
+            num_trained_   = (cfg_.llc_sets + leader_stride_ - 1) / leader_stride_;
+        }
+        const size_t sets_bytes = line_round((size_t)cfg_.llc_sets * rec_bytes());
+        state_bytes_ = sets_bytes + (sampled() ? num_trained_ * train_bytes() : 0);
+        if (posix_memalign((void **)&state_, CACHE_LINE, state_bytes_) != 0) {
+            std::cerr << "[SHiP-RRIP+] cannot allocate " << state_bytes_
+                      << " bytes of replacement state\n";
+            exit(EXIT_FAILURE);
+        }
+        memset(state_, 0, state_bytes_);
+        train_ = state_ + sets_bytes;
+#ifdef SHIP_SWAR_RRPV
+        rrpv_lsb_ = 0;
+        for (uint32_t w = 0; w < ways(); w++) {
+            rrpv_lsb_ |= (uint64_t)1 << (w * bits());
+        }
+#endif
+        // Initialize RRPVs; signatures and reuse bits start cleared
+        for (uint32_t s = 0; s < cfg_.llc_sets; s++) {
+            uint8_t *rec = record(s);
+            for (uint32_t w = 0; w < ways(); w++) {
+                set_rrpv(rec, w, max_rrpv());
+            }
+        }
+    }
+    ~ShipRrip() { free(state_); }
+
+    // Everything a checkpoint must restore; derived fields are rebuilt from
+    // the configuration
+    void state_blocks(std::vector<StateBlock> &blocks) override {
+        blocks.push_back(StateBlock(state_, state_bytes_));
+        blocks.push_back(StateBlock(shct_.data(), shct_.size()));
+        blocks.push_back(StateBlock(&stat_hits, sizeof(stat_hits)));
+        blocks.push_back(StateBlock(&stat_misses, sizeof(stat_misses)));
+        blocks.push_back(StateBlock(stat_type_hits, sizeof(stat_type_hits)));
+        blocks.push_back(StateBlock(stat_type_misses, sizeof(stat_type_misses)));
+        blocks.push_back(StateBlock(stat_type_insert, sizeof(stat_type_insert)));
+        blocks.push_back(StateBlock(stat_type_evictions, sizeof(stat_type_evictions)));
+        blocks.push_back(StateBlock(prefetched_.data(), prefetched_.size() * sizeof(uint64_t)));
+        blocks.push_back(StateBlock(&stat_bypasses, sizeof(stat_bypasses)));
+        blocks.push_back(StateBlock(&bypass_tick_, sizeof(bypass_tick_)));
+#ifdef SHIP_PRED_STATS
+        blocks.push_back(StateBlock(pred_lines_.data(), pred_lines_.size() * sizeof(LinePrediction)));
+        blocks.push_back(StateBlock(confusion_, sizeof(confusion_)));
+        blocks.push_back(StateBlock(sig_evictions_.data(), sig_evictions_.size() * sizeof(uint64_t)));
+        blocks.push_back(StateBlock(sig_correct_.data(), sig_correct_.size() * sizeof(uint64_t)));
+#endif
+    }
+
+    // A checkpoint may come from a run with a higher shct_max
+    void restored() override {
+        for (size_t i = 0; i < shct_.size(); i++) {
+            shct_[i] = std::min<uint8_t>(shct_[i], (uint8_t)cfg_.shct_max);
+        }
+    }
+
+    const std::vector<uint8_t> &shct() const override { return shct_; }
+
+    // Hardware storage budget of the policy state
+    void print_storage() const override {
+        uint32_t sig_bits = 0, ctr_bits = 0;
+        while ((1u << sig_bits) < shct_entries()) sig_bits++;
+        while ((1u << ctr_bits) <= cfg_.shct_max) ctr_bits++;
+        const double rrpv_kb  = (double)cfg_.llc_sets * ways() * bits() / 8192;
+        const double sig_kb   = (double)num_trained_ * ways() * sig_bits / 8192;
+        const double reuse_kb = (double)num_trained_ * ways() / 8192;
+        const double skip_kb  = cfg_.wb_aware ? reuse_kb : 0.0;
+        const double pf_kb    = cfg_.pf_aware ? (double)cfg_.llc_sets * ways() / 8192 : 0.0;
+        const double shct_kb  = (double)shct_entries() * ctr_bits / 8192;
+        std::cout << "  Storage (KB)  : RRPV " << rrpv_kb
+                  << ", signatures " << sig_kb << ", reuse " << reuse_kb;
+        if (cfg_.wb_aware) std::cout << ", no-train " << skip_kb;
+        if (cfg_.pf_aware) std::cout << ", prefetched " << pf_kb;
+        std::cout << ", SHCT " << shct_kb << ", total "
+                  << rrpv_kb + sig_kb + reuse_kb + skip_kb + pf_kb + shct_kb
+                  << " (" << num_trained_ << " training sets)\n";
+    }
+
+    bool specialized() const override {
+        return WAYS != DYN && BITS != DYN && SHCT_N != DYN && SHIFT != DYN;
+    }
+
+    uint32_t shct_index(uint32_t cpu, uint64_t PC, uint32_t type) const override {
+        return signature(cpu, PC, cfg_.pf_aware && type == PREFETCH);
+    }
+
+    // SRRIP victim selection. In bypass mode a fill whose SHCT counter is
+    // 0 skips the LLC (returns ways()), except writebacks, which must be
+    // allocated, and one in bypass_sample candidates, which is inserted
+    // normally so its signature can still learn reuse.
+    uint32_t victim(uint32_t cpu, uint32_t set, uint64_t PC,
+                    uint64_t paddr, uint32_t type) override {
+        if (cfg_.bypass && type != WRITEBACK &&
+            shct_[signature(cpu, PC, cfg_.pf_aware && type == PREFETCH)] == 0 &&
+            ++bypass_tick_ % cfg_.bypass_sample != 0) {
+            return ways();
+        }
+        return select_victim(record(set));
+    }
+
+    // Update replacement state on access or miss
+    void update(uint32_t cpu, uint32_t set, uint32_t way,
+                uint64_t paddr, uint64_t PC, uint64_t victim_addr,
+                uint32_t type, uint8_t hit) override {
+        // Bypassed fill: a miss that leaves the set untouched
+        if (way >= ways()) {
+            stat_misses++;
+            stat_bypasses++;
+            stat_type_misses[type < ACCESS_TYPES ? type : 0]++;
+            return;
+        }
+
+        // Local alias; train is NULL for follower sets when sampling
+        uint8_t  *rec        = record(set);
+        uint8_t  *train      = training(set, rec);
+        const uint64_t way_bit = (uint64_t)1 << way;
+        const uint32_t t       = type < ACCESS_TYPES ? type : 0;
+        // Writeback-aware mode: writebacks carry no useful PC and say nothing
+        // about demand reuse, so they neither read nor train the SHCT
+        const bool     wb      = cfg_.wb_aware && type == WRITEBACK;
+        // Prefetch-aware mode: prefetches train their own signatures, and
+        // prefetched lines are tracked until their first demand hit
+        const bool     pf      = cfg_.pf_aware && type == PREFETCH;
+
+        if (hit) {
+            // On hit: mark reused, promote to MRU AND strengthen SHCT
+            stat_hits++;
+            stat_type_hits[t]++;
+            if (wb || pf) return;
+#ifdef SHIP_PRED_STATS
+            pred_lines_[(size_t)set * ways() + way].reused = 1;
+#endif
+            const bool demand = type == LOAD || type == RFO;
+            if (cfg_.pf_aware && demand && (prefetched_[set] & way_bit)) {
+                // First demand use of a prefetched line: the prefetch paid
+                // off, but prefetched data is rarely reused again, so the
+                // line stays near eviction instead of moving to MRU
+                prefetched_[set] &= ~way_bit;
+                set_rrpv(rec, way, max_rrpv());
+                if (train && !(train_skip(train) & way_bit)) {
+                    train_reused(train) |= way_bit;
+                    sat_inc(shct_[train_sig(train)[way]], (uint8_t)cfg_.shct_max);
+                }
+                return;
+            }
+            set_rrpv(rec, way, 0);
+            if (train) {
+                train_reused(train) |= way_bit;
+                if (!(train_skip(train) & way_bit)) {
+                    sat_inc(shct_[train_sig(train)[way]], (uint8_t)cfg_.shct_max);
+                }
             }
+            return;
         }
-        // Aging step
-        if (attempt == 0) {
-            for (uint32_t w = 0; w < LLC_WAYS; w++) {
-                if (repl_rrpv[cpu][set][w] < MAX_RRPV) {
-                    repl_rrpv[cpu][set][w]++;
+
+        // On miss
+        stat_misses++;
+        stat_type_misses[t]++;
+        if (victim_addr) stat_type_evictions[t]++;
+
+        // Compute new signature
+        uint16_t newsig = signature(cpu, PC, pf);
+
+        if (train) {
+            uint64_t &reused   = train_reused(train);
+            uint64_t &skip     = train_skip(train);
+            uint16_t &line_sig = train_sig(train)[way];
+
+            // Update SHCT for the evicted block, unless a writeback filled it
+            if (!(skip & way_bit)) {
+                uint8_t &old_ctr = shct_[line_sig];
+                if (reused & way_bit) {
+                    sat_inc(old_ctr, (uint8_t)cfg_.shct_max);
+                } else {
+                    sat_dec(old_ctr);
                 }
             }
+            line_sig    = newsig;
+            reused     &= ~way_bit;
+            skip        = wb ? (skip | way_bit) : (skip & ~way_bit);
+        }
+
+        if (cfg_.pf_aware) {
+            prefetched_[set] = pf ? (prefetched_[set] | way_bit) : (prefetched_[set] & ~way_bit);
+        }
+
+        // Adaptive insertion policy; writeback fills go in at distant RRPV
+        // and prefetch fills no closer than max_rrpv() - 1
+        uint32_t pred = wb ? 0 : shct_[newsig];
+        uint8_t  ins_rrpv;
+        uint32_t ins_class;
+        if (pf) {
+            ins_rrpv  = (pred >= cfg_.threshold && max_rrpv() >= 2) ? max_rrpv() - 1 : max_rrpv();
+            ins_class = ins_rrpv == max_rrpv() ? 3 : 2;
+        } else if (pred >= cfg_.threshold + 2) {
+            ins_rrpv  = 0;
+            ins_class = 0;
+        } else if (pred >= cfg_.threshold) {
+            ins_rrpv  = 1;
+            ins_class = 1;
+        } else if (pred > 0) {
+            ins_rrpv  = (max_rrpv() >= 2) ? max_rrpv() - 1 : max_rrpv();
+            ins_class = 2;
         } else {
-            for (uint32_t w = 0; w < LLC_WAYS; w++) {
-                if (repl_rrpv[cpu][set][w] < MAX_RRPV) {
-                    repl_rrpv[cpu][set][w] =
-                        (repl_rrpv[cpu][set][w] + 2 > MAX_RRPV) ?
-                        MAX_RRPV : repl_rrpv[cpu][set][w] + 2;
-                }
+            ins_rrpv  = max_rrpv();
+            ins_class = 3;
+        }
+        stat_type_insert[t][ins_class]++;
+        set_rrpv(rec, way, ins_rrpv);
+#ifdef SHIP_PRED_STATS
+        record_prediction(set, way, newsig, pred >= cfg_.threshold, !wb);
+#endif
+    }
+
+  private:
+    // Parameters: the template argument when fixed, else the runtime value
+    uint32_t ways()       const { return WAYS   ? WAYS   : cfg_.llc_ways; }
+    uint32_t bits()       const { return BITS   ? BITS   : cfg_.rrpv_bits; }
+    uint32_t shct_size()  const { return SHCT_N ? SHCT_N : cfg_.shct_size; }
+    uint32_t shift()      const { return SHIFT  ? SHIFT  : cfg_.sign_shift; }
+    uint32_t shct_mask()  const { return shct_size() - 1; }
+    uint8_t  max_rrpv()   const { return (uint8_t)((1u << bits()) - 1); }
+    uint32_t shct_entries() const {
+        return shct_size() * (cfg_.shct_mode == SHCT_CORE_BANKED ? cfg_.num_core : 1);
+    }
+
+    // SHCT index of an access by cpu at PC. Lines store this index directly,
+    // so training on hits and evictions needs no recomputation. In
+    // prefetch-aware mode the index MSB is reserved: set for prefetches,
+    // clear for everything else, so the two never share a counter.
+    uint32_t signature(uint32_t cpu, uint64_t PC, bool prefetch) const {
+        uint32_t sig = (uint32_t)(PC >> shift());
+        if (cfg_.shct_mode == SHCT_CORE_HASH) {
+            sig ^= (cpu * 0x9E3779B1u) >> 16;     // core 0 keeps plain PC signatures
+        }
+        sig &= shct_mask();
+        if (cfg_.pf_aware) {
+            const uint32_t half = shct_size() >> 1;
+            sig = (sig & (half - 1)) | (prefetch ? half : 0);
+        }
+        if (cfg_.shct_mode == SHCT_CORE_BANKED) sig += cpu * shct_size();
+        return sig;
+    }
+
+    // Replacement state per set: RRPVs, reuse bits and signatures of all
+    // ways packed into one cache-line-aligned record, so an access touches
+    // one or two lines of metadata instead of three distant arrays. Layout:
+    //   [RRPV area][uint64_t reuse mask][uint64_t no-train mask]
+    //   [uint16_t signature per way]
+    // padded to whole cache lines (16 ways -> 64 bytes, 32 ways -> 112).
+    // The no-train mask flags writeback fills in writeback-aware mode.
+    // Build with -DSHIP_SWAR_RRPV to keep the RRPVs as bits()-wide lanes
+    // of one 64-bit word instead of a byte per way.
+    //
+    // With leader_sets > 0 only every leader_stride_-th set keeps the
+    // training half ([masks][signatures]) and updates the SHCT;
+    // follower records shrink to the RRPV area and only read the SHCT at
+    // insertion. Leader training records follow the RRPV array.
+    bool sampled() const { return cfg_.leader_sets != 0; }
+    static size_t line_round(size_t n) {
+        return (n + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+    }
+    size_t rrpv_bytes() const {
+#ifdef SHIP_SWAR_RRPV
+        return sizeof(uint64_t);
+#else
+        return (ways() + 7) & ~(size_t)7;
+#endif
+    }
+    size_t train_bytes() const {
+        size_t raw = 2 * sizeof(uint64_t) + ways() * sizeof(uint16_t);
+        return sampled() ? line_round(raw) : raw;
+    }
+    size_t rec_bytes() const {
+        return sampled() ? rrpv_bytes() : line_round(rrpv_bytes() + train_bytes());
+    }
+    uint8_t *record(uint32_t set) const {
+        return state_ + (size_t)set * rec_bytes();
+    }
+    uint8_t *training(uint32_t set, uint8_t *rec) const {
+        if (!sampled()) return rec + rrpv_bytes();
+        if (set % leader_stride_ != 0) return NULL;
+        return train_ + (size_t)(set / leader_stride_) * train_bytes();
+    }
+    static uint64_t &train_reused(uint8_t *train) {
+        return *(uint64_t *)train;
+    }
+    static uint64_t &train_skip(uint8_t *train) {
+        return *(uint64_t *)(train + sizeof(uint64_t));
+    }
+    static uint16_t *train_sig(uint8_t *train) {
+        return (uint16_t *)(train + 2 * sizeof(uint64_t));
+    }
+
+#ifdef SHIP_SWAR_RRPV
+    // SWAR helpers over the packed RRPV word. Every operation works on all
+    // ways at once; rrpv_lsb_ has the lowest bit of each lane set.
+    void set_rrpv(uint8_t *rec, uint32_t way, uint8_t v) const {
+        uint64_t &word = *(uint64_t *)rec;
+        const uint32_t lane = way * bits();
+        word = (word & ~((uint64_t)max_rrpv() << lane)) | ((uint64_t)v << lane);
+    }
+
+    // Pick the lowest way holding the largest RRPV and age the set so it
+    // reaches max_rrpv(). The maximum is found MSB first, narrowing the
+    // candidate lanes one bit at a time; aging cannot carry across lanes
+    // since no lane exceeds it.
+    uint32_t select_victim(uint8_t *rec) const {
+        uint64_t &word = *(uint64_t *)rec;
+        uint64_t  cand = rrpv_lsb_;
+        uint8_t   max  = 0;
+        for (int b = (int)bits() - 1; b >= 0; b--) {
+            uint64_t with_bit = (word >> b) & cand;
+            if (with_bit) {
+                cand = with_bit;
+                max |= (uint8_t)(1 << b);
+            }
+        }
+        word += (uint64_t)(max_rrpv() - max) * rrpv_lsb_;
+        return __builtin_ctzll(cand) / bits();
+    }
+#else
+    void set_rrpv(uint8_t *rec, uint32_t way, uint8_t v) const {
+        rec[way] = v;
+    }
+
+    // Pick the lowest way holding the largest RRPV. Aging the whole set by
+    // (max_rrpv() - max) in one step gives the same victim and end state as
+    // repeated +1 aging rounds.
+    uint32_t select_victim(uint8_t *rec) const {
+        uint8_t  max;
+        uint32_t victim = find_victim_way(rec, ways(), max);
+        if (max < max_rrpv()) {
+            age_rrpv(rec, ways(), max_rrpv() - max, max_rrpv());
+        }
+        return victim;
+    }
+#endif // SHIP_SWAR_RRPV
+
+#ifdef SHIP_PRED_STATS
+    // Outcome tracking for every resident line, kept outside the set records
+    // so it covers follower sets too
+    struct LinePrediction {
+        uint16_t sig;
+        uint8_t  valid;
+        uint8_t  predicted : 1, reused : 1;
+    };
+
+    // Score the line leaving this way, then start tracking its replacement.
+    // Fills that never consulted the SHCT (writebacks in writeback-aware
+    // mode) made no prediction and are left out.
+    void record_prediction(uint32_t set, uint32_t way, uint16_t sig, bool predicted,
+                           bool tracked) {
+        LinePrediction &line = pred_lines_[(size_t)set * ways() + way];
+        if (line.valid) {
+            confusion_[line.predicted][line.reused]++;
+            sig_evictions_[line.sig]++;
+            sig_correct_[line.sig] += line.predicted == line.reused;
+        }
+        line.sig       = sig;
+        line.valid     = tracked;
+        line.predicted = predicted;
+        line.reused    = 0;
+    }
+
+  public:
+    // Confusion matrix over evicted lines and the signatures with the most
+    // mispredictions; lines still resident at the end are not scored
+    void print_prediction_stats() const override {
+        const uint64_t total = confusion_[0][0] + confusion_[0][1] +
+                               confusion_[1][0] + confusion_[1][1];
+        std::cout << "  SHCT prediction (" << total << " evicted lines):\n";
+        std::cout << "    predicted reuse: " << confusion_[1][1] << " reused, "
+                  << confusion_[1][0] << " dead\n";
+        std::cout << "    predicted dead : " << confusion_[0][1] << " reused, "
+                  << confusion_[0][0] << " dead\n";
+        if (total) {
+            std::cout << "    accuracy " << (double)(confusion_[1][1] + confusion_[0][0]) / total
+                      << ", lost hits " << (double)confusion_[0][1] / total
+                      << ", wasted space " << (double)confusion_[1][0] / total << "\n";
+        }
+
+        std::vector<uint32_t> sigs;
+        for (uint32_t i = 0; i < sig_evictions_.size(); i++) {
+            if (sig_evictions_[i] != sig_correct_[i]) sigs.push_back(i);
+        }
+        const size_t top = std::min<size_t>(sigs.size(), 10);
+        std::partial_sort(sigs.begin(), sigs.begin() + top, sigs.end(),
+                          [this](uint32_t a, uint32_t b) {
+            return sig_evictions_[a] - sig_correct_[a] > sig_evictions_[b] - sig_correct_[b];
+        });
+        if (top) std::cout << "    most mispredicted signatures (sig: evictions, accuracy):\n";
+        for (size_t i = 0; i < top; i++) {
+            const uint32_t sig = sigs[i];
+            std::cout << "      " << sig << ": " << sig_evictions_[sig] << ", "
+                      << (double)sig_correct_[sig] / sig_evictions_[sig] << "\n";
+        }
+    }
+
+  private:
+#endif
+
+    const ShipConfig     cfg_;
+    uint8_t             *state_;     // [llc_sets] records
+    size_t               state_bytes_;
+    uint8_t             *train_;     // leader training records (sampled)
+    uint32_t             leader_stride_;
+    uint32_t             num_trained_;   // sets that keep training state
+#ifdef SHIP_SWAR_RRPV
+    uint64_t             rrpv_lsb_;
+#endif
+    std::vector<uint8_t> shct_;      // per-signature saturating counters
+                                     // (num_core banks in SHCT_CORE_BANKED)
+    std::vector<uint64_t> prefetched_;   // per set: ways filled by a prefetch
+                                         // and not yet demand-hit (pf_aware)
+    uint64_t             bypass_tick_ = 0;   // bypass candidates seen
+#ifdef SHIP_PRED_STATS
+    std::vector<LinePrediction> pred_lines_;     // [llc_sets * ways]
+    uint64_t                    confusion_[2][2] = {};  // [predicted][reused]
+    std::vector<uint64_t>       sig_evictions_;  // per signature
+    std::vector<uint64_t>       sig_correct_;
+#endif
+};
+
+// Pick a pre-instantiated core for common configurations; anything else
+// runs on the generic core with runtime parameters.
+static ReplPolicy *make_policy(const ShipConfig &c) {
+#define SHIP_INSTANCE(W, B, N, S)                                          \
+    if (c.llc_ways == W && c.rrpv_bits == B &&                             \
+        c.shct_size == N && c.sign_shift == S) {                           \
+        return new ShipRrip<W, B, N, S>(c);                                \
+    }
+    SHIP_INSTANCE(16, 3,  1024, 4)
+    SHIP_INSTANCE(16, 2,  1024, 4)
+    SHIP_INSTANCE(16, 3, 16384, 4)
+    SHIP_INSTANCE( 8, 3,  1024, 4)
+    SHIP_INSTANCE(32, 3,  1024, 4)
+    SHIP_INSTANCE(32, 3, 16384, 4)
+#undef SHIP_INSTANCE
+    return new ShipRrip<DYN, DYN, DYN, DYN>(c);
+}
+
+static ReplPolicy *policy;
+
+// Shadow mode: $SHIP_SHADOW lists policy variants, separated by ';', each a
+// comma-separated list of key=value overrides of the main configuration.
+// Every variant runs on its own tag array, fed the access stream the real
+// LLC sees in UpdateReplacementState, so one simulation compares them all.
+static const uint64_t SHADOW_INVALID = ~(uint64_t)0;
+static const uint32_t SHADOW_LOG2_BLOCK = 6;
+
+class ShadowCache {
+  public:
+    ShadowCache(const std::string &spec, const ShipConfig &c)
+        : spec_(spec), cfg_(c), policy_(make_policy(c)),
+          tags_((size_t)c.llc_sets * c.llc_ways, SHADOW_INVALID) {}
+    ~ShadowCache() { delete policy_; }
+
+    const std::string &spec() const { return spec_; }
+    const ShipConfig  &config() const { return cfg_; }
+    const ReplPolicy  &policy() const { return *policy_; }
+
+    // Look the block up in the shadow set, filling it on a miss. The LLC set
+    // is reused when the geometry matches, else the block is rehashed.
+    void access(uint32_t cpu, uint32_t set, uint64_t paddr, uint64_t PC,
+                uint32_t type, uint32_t llc_sets) {
+        const uint64_t block = paddr >> SHADOW_LOG2_BLOCK;
+        if (cfg_.llc_sets != llc_sets) set = (uint32_t)(block % cfg_.llc_sets);
+        uint64_t *set_tags = &tags_[(size_t)set * cfg_.llc_ways];
+        uint32_t  way = 0;
+        while (way < cfg_.llc_ways && set_tags[way] != block) way++;
+        if (way < cfg_.llc_ways) {
+            policy_->update(cpu, set, way, paddr, PC, 0, type, 1);
+            return;
+        }
+        way = policy_->victim(cpu, set, PC, paddr, type);
+        if (way >= cfg_.llc_ways) {
+            policy_->update(cpu, set, cfg_.llc_ways, paddr, PC, 0, type, 0);
+            return;
+        }
+        const uint64_t victim_addr =
+            set_tags[way] == SHADOW_INVALID ? 0 : set_tags[way] << SHADOW_LOG2_BLOCK;
+        set_tags[way] = block;
+        policy_->update(cpu, set, way, paddr, PC, victim_addr, type, 0);
+    }
+
+    void state_blocks(std::vector<StateBlock> &blocks) {
+        policy_->state_blocks(blocks);
+        blocks.push_back(StateBlock(tags_.data(), tags_.size() * sizeof(uint64_t)));
+    }
+    void restored() { policy_->restored(); }
+
+  private:
+    ShadowCache(const ShadowCache &);
+    ShadowCache &operator=(const ShadowCache &);
+
+    const std::string     spec_;
+    const ShipConfig      cfg_;
+    ReplPolicy           *policy_;
+    std::vector<uint64_t> tags_;
+};
+static std::vector<ShadowCache *> shadows;
+
+#ifdef SHIP_PC_STATS
+// Per-PC miss attribution (-DSHIP_PC_STATS). Two Space-Saving sketches of
+// PC_SKETCH_SIZE counters each track the PCs with the most misses and the
+// most dead-on-arrival insertions (lines evicted without a hit) in bounded
+// memory; each count overestimates by at most its reported error.
+static const uint32_t PC_SKETCH_SIZE = 256;
+static const uint32_t PC_REPORT_TOP  = 10;
+
+class SpaceSaving {
+  public:
+    struct Entry {
+        uint64_t key, count, error;
+    };
+
+    void add(uint64_t key) {
+        std::unordered_map<uint64_t, uint32_t>::iterator it = pos_.find(key);
+        if (it != pos_.end()) {
+            heap_[it->second].count++;
+            sift_down(it->second);
+            return;
+        }
+        if (heap_.size() < PC_SKETCH_SIZE) {
+            Entry e = { key, 1, 0 };
+            heap_.push_back(e);
+            pos_[key] = (uint32_t)heap_.size() - 1;
+            sift_up((uint32_t)heap_.size() - 1);
+            return;
+        }
+        // Evict the smallest counter; the newcomer inherits it as error
+        pos_.erase(heap_[0].key);
+        heap_[0].error = heap_[0].count;
+        heap_[0].count++;
+        heap_[0].key   = key;
+        pos_[key]      = 0;
+        sift_down(0);
+    }
+
+    std::vector<Entry> top(size_t n) const {
+        std::vector<Entry> out(heap_);
+        n = std::min(n, out.size());
+        std::partial_sort(out.begin(), out.begin() + n, out.end(),
+                          [](const Entry &a, const Entry &b) { return a.count > b.count; });
+        out.resize(n);
+        return out;
+    }
+
+    const std::vector<Entry> &entries() const { return heap_; }
+
+  private:
+    // Min-heap on count, with pos_ tracking each key's slot
+    void swap_entries(uint32_t a, uint32_t b) {
+        std::swap(heap_[a], heap_[b]);
+        pos_[heap_[a].key] = a;
+        pos_[heap_[b].key] = b;
+    }
+    void sift_up(uint32_t i) {
+        while (i > 0 && heap_[(i - 1) / 2].count > heap_[i].count) {
+            swap_entries(i, (i - 1) / 2);
+            i = (i - 1) / 2;
+        }
+    }
+    void sift_down(uint32_t i) {
+        for (;;) {
+            uint32_t l = 2 * i + 1, r = l + 1, m = i;
+            if (l < heap_.size() && heap_[l].count < heap_[m].count) m = l;
+            if (r < heap_.size() && heap_[r].count < heap_[m].count) m = r;
+            if (m == i) return;
+            swap_entries(i, m);
+            i = m;
+        }
+    }
+
+    std::vector<Entry>                     heap_;
+    std::unordered_map<uint64_t, uint32_t> pos_;
+};
+
+class PcProfiler {
+  public:
+    void reset(const ShipConfig &c) {
+        cfg_ = c;
+        lines_.assign((size_t)c.llc_sets * c.llc_ways, Line());
+        misses_ = SpaceSaving();
+        doa_    = SpaceSaving();
+    }
+
+    // Only demand (LOAD/RFO) misses are attributed; writebacks carry no PC
+    // and would top the list as PC 0. Writeback fills are not tracked as
+    // dead-on-arrival insertions for the same reason.
+    void access(uint32_t set, uint32_t way, uint64_t PC, uint32_t type, uint8_t hit) {
+        const bool demand = type == LOAD || type == RFO;
+        if (way >= cfg_.llc_ways) {
+            if (!hit && demand) misses_.add(PC);
+            return;
+        }
+        Line &line = lines_[(size_t)set * cfg_.llc_ways + way];
+        if (hit) {
+            line.reused = 1;
+            return;
+        }
+        if (demand) misses_.add(PC);
+        if (line.valid && !line.reused) doa_.add(line.pc);
+        line.pc     = PC;
+        line.valid  = type != WRITEBACK;
+        line.reused = 0;
+    }
+
+    void print() const {
+        print_top("demand misses", misses_);
+        print_top("dead-on-arrival insertions", doa_);
+    }
+
+  private:
+    struct Line {
+        uint64_t pc     = 0;
+        uint8_t  valid  = 0;
+        uint8_t  reused = 0;
+    };
+
+    // Base signature of a PC (before any core hashing); PCs sharing it alias
+    // in the SHCT
+    uint32_t signature(uint64_t PC) const {
+        return (uint32_t)((PC >> cfg_.sign_shift) & (cfg_.shct_size - 1));
+    }
+
+    void print_top(const char *what, const SpaceSaving &sketch) const {
+        std::vector<SpaceSaving::Entry> top = sketch.top(PC_REPORT_TOP);
+        if (top.empty()) return;
+        std::cout << "  Top PCs by " << what << " (PC: count +/- error, signature, tracked PCs on it):\n";
+        for (size_t i = 0; i < top.size(); i++) {
+            const uint32_t sig = signature(top[i].key);
+            uint32_t aliases = 0;
+            for (const SpaceSaving::Entry &e : sketch.entries()) {
+                aliases += signature(e.key) == sig;
+            }
+            std::cout << "    0x" << std::hex << top[i].key << std::dec << ": "
+                      << top[i].count << " +/- " << top[i].error << ", sig " << sig
+                      << ", " << aliases << "\n";
+        }
+    }
+
+    ShipConfig        cfg_;
+    std::vector<Line> lines_;    // inserting PC of every resident line
+    SpaceSaving       misses_;
+    SpaceSaving       doa_;
+};
+static PcProfiler pc_stats;
+#endif
+
+#ifdef SHIP_RD_STATS
+// Sampled reuse-distance profile (-DSHIP_RD_STATS), SHARDS style: blocks
+// whose hash falls in 1/RD_SAMPLE_MOD of the hash space are tracked exactly
+// and their stack distances scaled back up. Each reuse is charged to the
+// signature and type of the previous access to the block, i.e. the access
+// whose insertion or promotion it rewards, and bucketed against the LLC
+// capacity. Blocks never touched again land in the "none" bucket at the end.
+#ifndef SHIP_RD_SAMPLE
+#define SHIP_RD_SAMPLE 64
+#endif
+static const uint64_t RD_SAMPLE_MOD = SHIP_RD_SAMPLE;
+static const uint32_t RD_BUCKETS    = 7;
+static const char *rd_bucket_names[RD_BUCKETS] = {
+    "<C/4", "<C/2", "<C", "<2C", "<4C", ">=4C", "none"
+};
+static const uint32_t RD_NONE        = RD_BUCKETS - 1;
+static const uint32_t RD_REPORT_TOP  = 10;
+
+class ReuseProfiler {
+  public:
+    void reset(const ShipConfig &c, const ReplPolicy *p) {
+        policy_   = p;
+        capacity_ = (uint64_t)c.llc_sets * c.llc_ways;
+        now_      = 0;
+        last_.clear();
+        tree_.assign(1 << 16, 0);
+        sig_hist_.assign(p->shct().size() * RD_BUCKETS, 0);
+        memset(type_hist_, 0, sizeof(type_hist_));
+    }
+
+    void access(uint32_t cpu, uint64_t paddr, uint64_t PC, uint32_t type) {
+        const uint64_t block = paddr >> 6;
+        if (mix(block) % RD_SAMPLE_MOD != 0) return;
+
+        if (now_ + 1 >= tree_.size()) compact();
+        const uint64_t t = ++now_;
+        std::unordered_map<uint64_t, Last>::iterator it = last_.find(block);
+        if (it != last_.end()) {
+            // Distinct sampled blocks touched since the previous access
+            const uint64_t d = prefix(t - 1) - prefix(it->second.time);
+            count(it->second, bucket(d * RD_SAMPLE_MOD));
+            add(it->second.time, -1);
+        }
+        Last &l = last_[block];
+        l.time  = t;
+        l.sig   = policy_->shct_index(cpu, PC, type);
+        l.type  = type < ACCESS_TYPES ? type : 0;
+        add(t, 1);
+    }
+
+    // Works on copies of the histograms, so profiling can go on afterwards
+    void print() const {
+        std::vector<uint64_t> sig_hist(sig_hist_);
+        uint64_t type_hist[ACCESS_TYPES][RD_BUCKETS];
+        memcpy(type_hist, type_hist_, sizeof(type_hist));
+        for (std::unordered_map<uint64_t, Last>::const_iterator it = last_.begin();
+             it != last_.end(); ++it) {
+            sig_hist[(size_t)it->second.sig * RD_BUCKETS + RD_NONE]++;
+            type_hist[it->second.type][RD_NONE]++;
+        }
+
+        std::cout << "  Reuse distance (1/" << RD_SAMPLE_MOD << " of blocks sampled, C = "
+                  << capacity_ << " blocks):\n";
+        char head[160];
+        int  len = snprintf(head, sizeof(head), "    %-9s", "");
+        for (uint32_t b = 0; b < RD_BUCKETS; b++) {
+            len += snprintf(head + len, sizeof(head) - len, " %6s", rd_bucket_names[b]);
+        }
+        std::cout << head << "  (sampled accesses)\n";
+        for (uint32_t t = 0; t < ACCESS_TYPES; t++) {
+            print_row(access_type_names[t], type_hist[t], "");
+        }
+
+        // Busiest signatures, and whether most of their reuses (never-reused
+        // blocks aside) fall within the LLC capacity
+        const uint32_t entries = (uint32_t)(sig_hist.size() / RD_BUCKETS);
+        std::vector<uint32_t> sigs;
+        std::vector<uint64_t> total(entries, 0);
+        for (uint32_t s = 0; s < entries; s++) {
+            for (uint32_t b = 0; b < RD_BUCKETS; b++) total[s] += sig_hist[s * RD_BUCKETS + b];
+            if (total[s]) sigs.push_back(s);
+        }
+        const size_t top = std::min<size_t>(sigs.size(), RD_REPORT_TOP);
+        std::partial_sort(sigs.begin(), sigs.begin() + top, sigs.end(),
+                          [&total](uint32_t a, uint32_t b) { return total[a] > total[b]; });
+        for (size_t i = 0; i < top; i++) {
+            const uint64_t *h      = &sig_hist[(size_t)sigs[i] * RD_BUCKETS];
+            const uint64_t  fit    = h[0] + h[1] + h[2];
+            const uint64_t  reuses = total[sigs[i]] - h[RD_NONE];
+            print_row(("sig " + std::to_string(sigs[i])).c_str(), h,
+                      !reuses ? "  never reused" :
+                      fit * 2 >= reuses ? "  fits in LLC" : "  beyond LLC");
+        }
+    }
+
+  private:
+    struct Last {
+        uint64_t time;
+        uint32_t sig;
+        uint32_t type;
+    };
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 33;
+        x *= 0xff51afd7ed558ccdull;
+        x ^= x >> 33;
+        x *= 0xc4ceb9fe1a85ec53ull;
+        return x ^ (x >> 33);
+    }
+
+    uint32_t bucket(uint64_t d) const {
+        if (d * 4 < capacity_) return 0;
+        if (d * 2 < capacity_) return 1;
+        if (d < capacity_)     return 2;
+        if (d < capacity_ * 2) return 3;
+        if (d < capacity_ * 4) return 4;
+        return 5;
+    }
+
+    void count(const Last &l, uint32_t b) {
+        sig_hist_[(size_t)l.sig * RD_BUCKETS + b]++;
+        type_hist_[l.type][b]++;
+    }
+
+    void print_row(const char *name, const uint64_t *h, const char *verdict) const {
+        uint64_t n = 0;
+        for (uint32_t b = 0; b < RD_BUCKETS; b++) n += h[b];
+        char line[160];
+        int  len = snprintf(line, sizeof(line), "    %-9s", name);
+        for (uint32_t b = 0; b < RD_BUCKETS && len < (int)sizeof(line); b++) {
+            len += snprintf(line + len, sizeof(line) - len, " %5.1f%%",
+                            n ? 100.0 * h[b] / n : 0.0);
+        }
+        std::cout << line << "  (" << n << ")" << verdict << "\n";
+    }
+
+    // Fenwick tree over access times holding a 1 at each block's latest
+    // access, so a range sum counts distinct blocks
+    void add(uint64_t i, int64_t v) {
+        for (; i < tree_.size(); i += i & (~i + 1)) tree_[i] += v;
+    }
+    uint64_t prefix(uint64_t i) const {
+        int64_t sum = 0;
+        for (; i > 0; i -= i & (~i + 1)) sum += tree_[i];
+        return (uint64_t)sum;
+    }
+
+    // Renumber live blocks 1..n in time order and size the tree to 4n
+    void compact() {
+        std::vector<std::pair<uint64_t, uint64_t> > order;   // (time, block)
+        order.reserve(last_.size());
+        for (std::unordered_map<uint64_t, Last>::const_iterator it = last_.begin();
+             it != last_.end(); ++it) {
+            order.push_back(std::make_pair(it->second.time, it->first));
+        }
+        std::sort(order.begin(), order.end());
+        tree_.assign(std::max<size_t>(order.size() * 4, 1 << 16), 0);
+        for (size_t i = 0; i < order.size(); i++) {
+            last_[order[i].second].time = i + 1;
+            add(i + 1, 1);
+        }
+        now_ = order.size();
+    }
+
+    const ReplPolicy                  *policy_;
+    uint64_t                           capacity_;
+    uint64_t                           now_;
+    std::unordered_map<uint64_t, Last> last_;
+    std::vector<int64_t>               tree_;
+    std::vector<uint64_t>              sig_hist_;    // [SHCT entries][RD_BUCKETS]
+    uint64_t                           type_hist_[ACCESS_TYPES][RD_BUCKETS];
+};
+static ReuseProfiler rd_stats;
+#endif
+
+// Capture mode: with $SHIP_CAPTURE=<file> every UpdateReplacementState call
+// is recorded as an LlcAccess (llc_trace.h) for replay.cc; victim selection
+// is implied by the fills. Records are batched and handed to a background
+// thread that writes them through gzip/xz (by file suffix), so the
+// simulation thread only copies 32 bytes per access.
+class CaptureWriter {
+  public:
+    bool active() const { return out_ != NULL; }
+    uint64_t records() const { return records_; }
+
+    void open(const char *path, const LlcTraceHeader &hdr) {
+        std::string p = path;
+        const char *cmd = p.size() > 3 && p.compare(p.size() - 3, 3, ".gz") == 0 ? "gzip -1 > '" :
+                          p.size() > 3 && p.compare(p.size() - 3, 3, ".xz") == 0 ? "xz -1 > '"   : NULL;
+        piped_ = cmd != NULL;
+        out_   = piped_ ? popen((std::string(cmd) + p + "'").c_str(), "w")
+                        : fopen(path, "wb");
+        if (!out_ || fwrite(&hdr, sizeof(hdr), 1, out_) != 1) {
+            std::cerr << "[SHiP-RRIP+] cannot write capture file " << path << "\n";
+            exit(EXIT_FAILURE);
+        }
+        path_    = p;
+        records_ = 0;
+        closing_ = false;
+        batch_.reserve(BATCH);
+        pending_.reserve(BATCH);
+        thread_ = std::thread(&CaptureWriter::run, this);
+    }
+
+    void push(const LlcAccess &a) {
+        batch_.push_back(a);
+        records_++;
+        if (batch_.size() == BATCH) hand_off();
+    }
+
+    // Drain all batches and close the stream
+    void close() {
+        if (!out_) return;
+        if (!batch_.empty()) hand_off();
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            closing_ = true;
+        }
+        cv_.notify_all();
+        thread_.join();
+        if (piped_) pclose(out_); else fclose(out_);
+        out_ = NULL;
+        std::cout << "  Captured      : " << records_ << " accesses -> " << path_ << "\n";
+    }
+    ~CaptureWriter() { close(); }
+
+  private:
+    static const size_t BATCH = 1 << 16;      // 2 MB of records
+
+    // Queue the full batch for the writer, waiting if it is still busy
+    void hand_off() {
+        std::unique_lock<std::mutex> lk(mu_);
+        cv_.wait(lk, [this] { return pending_.empty(); });
+        pending_.swap(batch_);
+        lk.unlock();
+        cv_.notify_all();
+    }
+
+    void run() {
+        std::vector<LlcAccess> writing;
+        writing.reserve(BATCH);
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lk(mu_);
+                cv_.wait(lk, [this] { return !pending_.empty() || closing_; });
+                if (pending_.empty()) return;
+                writing.swap(pending_);
+            }
+            cv_.notify_all();
+            fwrite(writing.data(), sizeof(LlcAccess), writing.size(), out_);
+            writing.clear();
+        }
+    }
+
+    FILE                   *out_ = NULL;
+    bool                    piped_ = false;
+    std::string             path_;
+    uint64_t                records_ = 0;
+    std::thread             thread_;
+    std::mutex              mu_;
+    std::condition_variable cv_;
+    bool                    closing_ = false;
+    std::vector<LlcAccess>  batch_;           // filled by the simulation
+    std::vector<LlcAccess>  pending_;         // full batch queued for the writer
+};
+static CaptureWriter capture;
+
+// Apply one configuration key; returns false for unknown keys
+static bool set_config_value(ShipConfig &c, const std::string &key, uint64_t v) {
+    if      (key == "num_core")   c.num_core   = (uint32_t)v;
+    else if (key == "llc_sets")   c.llc_sets   = (uint32_t)v;
+    else if (key == "llc_ways")   c.llc_ways   = (uint32_t)v;
+    else if (key == "rrpv_bits")  c.rrpv_bits  = (uint32_t)v;
+    else if (key == "shct_size")  c.shct_size  = (uint32_t)v;
+    else if (key == "sign_shift") c.sign_shift = (uint32_t)v;
+    else if (key == "shct_mode")  c.shct_mode  = (uint32_t)v;
+    else if (key == "leader_sets") c.leader_sets = (uint32_t)v;
+    else if (key == "shct_max")   c.shct_max   = (uint32_t)v;
+    else if (key == "shct_init")  c.shct_init  = (uint32_t)v;
+    else if (key == "threshold")  c.threshold  = (uint32_t)v;
+    else if (key == "wb_aware")   c.wb_aware   = (uint32_t)v;
+    else if (key == "pf_aware")   c.pf_aware   = (uint32_t)v;
+    else if (key == "bypass")     c.bypass     = (uint32_t)v;
+    else if (key == "bypass_sample") c.bypass_sample = (uint32_t)v;
+    else return false;
+    return true;
+}
+
+static std::string trim(const std::string &str) {
+    size_t b = str.find_first_not_of(" \t\r");
+    size_t e = str.find_last_not_of(" \t\r");
+    return b == std::string::npos ? "" : str.substr(b, e - b + 1);
+}
+
+// Reject configurations the policy cannot run
+static void validate_config(const ShipConfig &c) {
+    if (c.num_core == 0 || c.llc_ways == 0 || c.llc_ways > MAX_WAYS) {
+        std::cerr << "[SHiP-RRIP+] unsupported geometry: " << c.num_core
+                  << " cores, " << c.llc_ways << " ways\n";
+        exit(EXIT_FAILURE);
+    }
+    if (c.rrpv_bits == 0 || c.rrpv_bits > 7 || c.shct_size == 0 ||
+        c.shct_size > 65536 || (c.shct_size & (c.shct_size - 1)) != 0) {
+        std::cerr << "[SHiP-RRIP+] unsupported rrpv_bits " << c.rrpv_bits
+                  << " or shct_size " << c.shct_size << "\n";
+        exit(EXIT_FAILURE);
+    }
+    if (c.shct_mode > SHCT_CORE_BANKED ||
+        (c.shct_mode == SHCT_CORE_BANKED &&
+         (uint64_t)c.num_core * c.shct_size > 65536)) {
+        std::cerr << "[SHiP-RRIP+] unsupported shct_mode " << c.shct_mode
+                  << " for " << c.num_core << " x " << c.shct_size
+                  << " SHCT entries\n";
+        exit(EXIT_FAILURE);
+    }
+    if (c.wb_aware > 1 || c.pf_aware > 1 || c.bypass > 1 || c.bypass_sample == 0) {
+        std::cerr << "[SHiP-RRIP+] wb_aware, pf_aware and bypass must be 0 or 1,"
+                  << " bypass_sample at least 1\n";
+        exit(EXIT_FAILURE);
+    }
+    if (c.shct_max == 0 || c.shct_max > 255 || c.shct_init > c.shct_max ||
+        c.threshold > c.shct_max) {
+        std::cerr << "[SHiP-RRIP+] unsupported SHCT counters: max " << c.shct_max
+                  << ", init " << c.shct_init << ", threshold " << c.threshold << "\n";
+        exit(EXIT_FAILURE);
+    }
+#ifdef SHIP_SWAR_RRPV
+    if (c.llc_ways * c.rrpv_bits > 64) {
+        std::cerr << "[SHiP-RRIP+] " << c.llc_ways
+                  << " ways do not fit a packed 64-bit RRPV word\n";
+        exit(EXIT_FAILURE);
+    }
+#endif
+}
+
+// Read runtime parameters: $SHIP_CONFIG file first, then $SHIP_<KEY> overrides
+static void load_config() {
+    static const char *keys[] = {
+        "num_core", "llc_sets", "llc_ways", "rrpv_bits", "shct_size", "sign_shift",
+        "shct_mode", "leader_sets", "shct_max", "shct_init", "threshold", "wb_aware",
+        "pf_aware", "bypass", "bypass_sample"
+    };
+
+    cfg = ShipConfig();
+    if (const char *path = getenv("SHIP_CONFIG")) {
+        std::ifstream in(path);
+        if (!in) {
+            std::cerr << "[SHiP-RRIP+] cannot open config file " << path << "\n";
+            exit(EXIT_FAILURE);
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) continue;
+            size_t eq = line.find('=');
+            std::string key = trim(line.substr(0, eq));
+            if (eq == std::string::npos ||
+                !set_config_value(cfg, key, strtoull(line.c_str() + eq + 1, NULL, 0))) {
+                std::cerr << "[SHiP-RRIP+] ignoring config line: " << line << "\n";
             }
         }
     }
-    // Fallback (should not be reached): pick way 0
-    return 0;
+    for (const char *key : keys) {
+        std::string var = "SHIP_";
+        for (const char *k = key; *k; k++) var += (char)toupper(*k);
+        if (const char *val = getenv(var.c_str())) {
+            set_config_value(cfg, key, strtoull(val, NULL, 0));
+        }
+    }
+    if (cfg.llc_sets == 0) cfg.llc_sets = cfg.num_core * 2048;
+
+    validate_config(cfg);
+}
+
+// Build the $SHIP_SHADOW variants on top of the main configuration
+static void load_shadows() {
+    for (size_t i = 0; i < shadows.size(); i++) delete shadows[i];
+    shadows.clear();
+    const char *env = getenv("SHIP_SHADOW");
+    if (!env) return;
+
+    std::string list = env;
+    size_t      pos  = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(';', pos);
+        if (end == std::string::npos) end = list.size();
+        const std::string spec = trim(list.substr(pos, end - pos));
+        pos = end + 1;
+        if (spec.empty()) continue;
+
+        ShipConfig c = cfg;
+        size_t     kpos = 0;
+        while (kpos <= spec.size()) {
+            size_t kend = spec.find(',', kpos);
+            if (kend == std::string::npos) kend = spec.size();
+            const std::string kv = spec.substr(kpos, kend - kpos);
+            kpos = kend + 1;
+            size_t eq = kv.find('=');
+            if (eq == std::string::npos ||
+                !set_config_value(c, trim(kv.substr(0, eq)),
+                                  strtoull(kv.c_str() + eq + 1, NULL, 0))) {
+                std::cerr << "[SHiP-RRIP+] bad shadow parameter '" << kv
+                          << "' in " << spec << "\n";
+                exit(EXIT_FAILURE);
+            }
+        }
+        validate_config(c);
+        shadows.push_back(new ShadowCache(spec, c));
+    }
+}
+
+static const char *shct_mode_names[] = { "shared", "core-hashed", "per-core" };
+
+// Heartbeats report the interval since the previous one: hit rate, MPKI,
+// the fraction of SHCT counters saturated high and the insertion mix.
+// Lines go to stdout without flushing; $SHIP_HEARTBEAT=<file> also writes
+// each interval as a JSON line through a large stdio buffer.
+struct HeartbeatSnapshot {
+    uint64_t instrs = 0, hits = 0, misses = 0;
+    uint64_t type_hits[ACCESS_TYPES]   = {};
+    uint64_t type_misses[ACCESS_TYPES] = {};
+    uint64_t insert[INSERT_CLASSES]    = {};
+};
+static HeartbeatSnapshot last_heartbeat;
+static FILE             *heartbeat_log;
+static uint64_t          heartbeat_seq;
+
+static void open_heartbeat_log() {
+    if (heartbeat_log) fclose(heartbeat_log);
+    heartbeat_log  = NULL;
+    heartbeat_seq  = 0;
+    last_heartbeat = HeartbeatSnapshot();
+    const char *path = getenv("SHIP_HEARTBEAT");
+    if (!path || !*path) return;
+    heartbeat_log = fopen(path, "w");
+    if (!heartbeat_log) {
+        std::cerr << "[SHiP-RRIP+] cannot open heartbeat log " << path << "\n";
+        return;
+    }
+    setvbuf(heartbeat_log, NULL, _IOFBF, 1 << 20);
+}
+
+static void close_heartbeat_log() {
+    if (heartbeat_log) fclose(heartbeat_log);
+    heartbeat_log = NULL;
+}
+
+// Counters at the end of warmup, once every core has retired
+// $SHIP_WARMUP instructions, so the stats record can report the measured
+// window that the simulator's own IPC and MPKI cover
+struct WarmupSnapshot {
+    uint64_t instrs = 0, cycles = 0, misses = 0;
+};
+static WarmupSnapshot warmup_end;
+static uint64_t       warmup_instrs;
+static bool           warmup_pending;
+
+static void reset_warmup() {
+    const char *env = getenv("SHIP_WARMUP");
+    warmup_end     = WarmupSnapshot();
+    warmup_instrs  = env ? strtoull(env, NULL, 0) : 0;
+    warmup_pending = warmup_instrs > 0;
+}
+
+static void check_warmup(uint32_t cpu) {
+    if (get_instr_count(cpu) < warmup_instrs) return;
+    uint64_t instrs = 0;
+    for (uint32_t c = 0; c < cfg.num_core; c++) {
+        if (get_instr_count(c) < warmup_instrs) return;
+        instrs += get_instr_count(c);
+    }
+    warmup_end.instrs = instrs;
+    warmup_end.cycles = get_cycle_count();
+    warmup_end.misses = policy->stat_misses;
+    warmup_pending    = false;
+}
+
+// Initialize replacement state
+void InitReplacementState() {
+    load_config();
+    delete policy;
+    policy = make_policy(cfg);
+    load_shadows();
+#ifdef SHIP_PC_STATS
+    pc_stats.reset(cfg);
+#endif
+#ifdef SHIP_RD_STATS
+    rd_stats.reset(cfg, policy);
+#endif
+    open_heartbeat_log();
+    reset_warmup();
+    const char *path = getenv("SHIP_CAPTURE");
+    if (path && *path) {
+        LlcTraceHeader hdr;
+        memcpy(hdr.magic, LLC_TRACE_MAGIC, sizeof(hdr.magic));
+        hdr.num_core = cfg.num_core;
+        hdr.llc_sets = cfg.llc_sets;
+        hdr.llc_ways = cfg.llc_ways;
+        hdr.reserved = 0;
+        capture.close();
+        capture.open(path, hdr);
+    }
+    std::cout << "[SHiP-RRIP+] " << cfg.llc_sets << " sets x " << cfg.llc_ways
+              << " ways, " << cfg.rrpv_bits << "-bit RRPV, " << cfg.shct_size
+              << "-entry SHCT, shift " << cfg.sign_shift << ", "
+              << shct_mode_names[cfg.shct_mode] << " SHCT"
+              << (cfg.wb_aware ? ", writeback-aware" : "")
+              << (cfg.pf_aware ? ", prefetch-aware" : "")
+              << (cfg.bypass ? ", bypass" : "") << " ("
+              << (policy->specialized() ? "specialized" : "generic") << " core)\n";
+    for (size_t i = 0; i < shadows.size(); i++) {
+        std::cout << "[SHiP-RRIP+] shadow " << shadows[i]->spec() << " ("
+                  << (shadows[i]->policy().specialized() ? "specialized" : "generic")
+                  << " core)\n";
+    }
+}
+
+// The simulator's LLC is fixed at build time while cfg comes from the
+// environment; an index outside cfg means the two disagree, and the state
+// arrays would be indexed out of bounds. way == llc_ways is a bypass.
+static void geometry_mismatch(const char *fn, uint32_t cpu, uint32_t set, uint32_t way) {
+    std::cerr << "[SHiP-RRIP+] " << fn << " got cpu " << cpu << ", set " << set
+              << ", way " << way << " outside the configured " << cfg.num_core
+              << " cores, " << cfg.llc_sets << " sets, " << cfg.llc_ways
+              << " ways; num_core, llc_sets and llc_ways must match the simulator's LLC\n";
+    exit(EXIT_FAILURE);
+}
+
+static inline void check_access(const char *fn, uint32_t cpu, uint32_t set, uint32_t way) {
+    if (cpu >= cfg.num_core || set >= cfg.llc_sets || way > cfg.llc_ways) {
+        geometry_mismatch(fn, cpu, set, way);
+    }
+}
+
+// SRRIP victim selection
+uint32_t GetVictimInSet(
+    uint32_t         cpu,
+    uint32_t         set,
+    const BLOCK     *current_set,
+    uint64_t         PC,
+    uint64_t         paddr,
+    uint32_t         type
+) {
+    check_access("GetVictimInSet", cpu, set, 0);
+    return policy->victim(cpu, set, PC, paddr, type);
 }
 
 // Update replacement state on access or miss
@@ -106,62 +1422,357 @@ void UpdateReplacementState(
     uint32_t type,
     uint8_t  hit
 ) {
-    // Local alias
-    uint8_t &line_rrpv   = repl_rrpv[cpu][set][way];
-    uint16_t &line_sig   = repl_sig[cpu][set][way];
-    uint8_t &line_reused = repl_reused[cpu][set][way];
-
-    if (hit) {
-        // On hit: mark reused, promote to MRU AND strengthen SHCT
-        stat_hits++;
-        line_reused = 1;
-        line_rrpv   = 0;
-        uint16_t sig = line_sig & (SHCT_SIZE - 1);
-        if (sig < SHCT_SIZE) sat_inc(SHCT[sig], SHCT_MAX);
-        return;
+    check_access("UpdateReplacementState", cpu, set, way);
+    if (capture.active()) {
+        LlcAccess a;
+        a.pc    = PC;
+        a.paddr = paddr;
+        a.instr = get_instr_count(cpu);
+        a.set   = set;
+        a.cpu   = (uint8_t)cpu;
+        a.type  = (uint8_t)type;
+        a.hit   = hit;
+        a.way   = (uint8_t)way;
+        capture.push(a);
+    }
+    if (warmup_pending) check_warmup(cpu);
+#ifdef SHIP_PC_STATS
+    pc_stats.access(set, way, PC, type, hit);
+#endif
+#ifdef SHIP_RD_STATS
+    rd_stats.access(cpu, paddr, PC, type);
+#endif
+    policy->update(cpu, set, way, paddr, PC, victim_addr, type, hit);
+    for (size_t i = 0; i < shadows.size(); i++) {
+        shadows[i]->access(cpu, set, paddr, PC, type, cfg.llc_sets);
     }
+}
 
-    // On miss
-    stat_misses++;
+// Warmup checkpoints, written and restored by replay.cc. The policy section
+// is a header (magic, configuration, block count) and a table of
+// num_blocks block sizes, followed by each state block at a page-aligned
+// offset, so a mapped file copies straight into place. Restoring requires
+// the same state layout in the main policy and every shadow; parameters
+// that only steer decisions may differ, so variants share one warmup.
+static const char CKPT_MAGIC[8] = { 'S', 'H', 'I', 'P', 'C', 'K', 'P', '3' };
 
-    // Update SHCT for the evicted block
-    uint16_t old_sig = line_sig & (SHCT_SIZE - 1);
-    if (old_sig < SHCT_SIZE) {
-        if (line_reused) {
-            sat_inc(SHCT[old_sig], SHCT_MAX);
-        } else {
-            sat_dec(SHCT[old_sig]);
+struct CheckpointHeader {
+    char     magic[8];
+    uint64_t layout_hash;                // FNV-1a of every policy's layout
+    uint32_t num_blocks;                 // uint64 block sizes follow
+};
+
+static size_t page_round(size_t n) {
+    return (n + CKPT_PAGE_SIZE - 1) & ~(size_t)(CKPT_PAGE_SIZE - 1);
+}
+
+// The parameters that size or index the saved state: geometry and SHCT
+// organization. threshold, shct_max, shct_init, sign_shift, wb_aware,
+// pf_aware, bypass and bypass_sample are free to change on restore.
+static void hash_layout(uint64_t &h, const ShipConfig &c) {
+    const uint32_t fields[] = { c.num_core, c.llc_sets, c.llc_ways, c.rrpv_bits,
+                                c.shct_size, c.shct_mode, c.leader_sets };
+    const uint8_t *p = (const uint8_t *)fields;
+    for (size_t i = 0; i < sizeof(fields); i++) h = (h ^ p[i]) * 0x100000001b3ull;
+}
+
+static uint64_t layout_hash() {
+    uint64_t h = 0xcbf29ce484222325ull;
+    hash_layout(h, cfg);
+    for (size_t i = 0; i < shadows.size(); i++) hash_layout(h, shadows[i]->config());
+    return h;
+}
+
+// The profilers' hash maps are not flat state blocks, so builds with them
+// cannot checkpoint; restoring would report a profile missing the warmup
+static bool checkpoint_supported() {
+#ifdef SHIP_PC_STATS
+    std::cerr << "[SHiP-RRIP+] checkpoints are not supported with -DSHIP_PC_STATS\n";
+    return false;
+#endif
+#ifdef SHIP_RD_STATS
+    std::cerr << "[SHiP-RRIP+] checkpoints are not supported with -DSHIP_RD_STATS\n";
+    return false;
+#endif
+    return true;
+}
+
+// Main policy state, each shadow's policy and tags, then the heartbeat
+// baseline so the first interval after a restore starts where it would have
+static void checkpoint_blocks(std::vector<StateBlock> &blocks) {
+    policy->state_blocks(blocks);
+    for (size_t i = 0; i < shadows.size(); i++) shadows[i]->state_blocks(blocks);
+    blocks.push_back(StateBlock(&last_heartbeat, sizeof(last_heartbeat)));
+    blocks.push_back(StateBlock(&heartbeat_seq, sizeof(heartbeat_seq)));
+}
+
+bool SaveReplacementState(FILE *out) {
+    if (!checkpoint_supported()) return false;
+    std::vector<StateBlock> blocks;
+    checkpoint_blocks(blocks);
+
+    CheckpointHeader hdr = CheckpointHeader();
+    memcpy(hdr.magic, CKPT_MAGIC, sizeof(hdr.magic));
+    hdr.layout_hash = layout_hash();
+    hdr.num_blocks  = (uint32_t)blocks.size();
+    std::vector<uint64_t> sizes(blocks.size());
+    for (size_t i = 0; i < blocks.size(); i++) sizes[i] = blocks[i].second;
+
+    static const char zeros[CKPT_PAGE_SIZE] = {};
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+              fwrite(sizes.data(), sizeof(uint64_t), sizes.size(), out) == sizes.size();
+    size_t pos = sizeof(hdr) + sizes.size() * sizeof(uint64_t);
+    for (size_t i = 0; ok && i < blocks.size(); i++) {
+        size_t pad = page_round(pos) - pos;
+        ok = fwrite(zeros, 1, pad, out) == pad &&
+             fwrite(blocks[i].first, 1, blocks[i].second, out) == blocks[i].second;
+        pos += pad + blocks[i].second;
+    }
+    if (!ok) {
+        std::cerr << "[SHiP-RRIP+] writing policy state failed: " << strerror(errno) << "\n";
+    }
+    return ok;
+}
+
+bool LoadReplacementState(const uint8_t *data, size_t size) {
+    if (!checkpoint_supported()) return false;
+    std::vector<StateBlock> blocks;
+    checkpoint_blocks(blocks);
+
+    CheckpointHeader hdr;
+    if (size < sizeof(hdr)) return false;
+    memcpy(&hdr, data, sizeof(hdr));
+    if (memcmp(hdr.magic, CKPT_MAGIC, sizeof(hdr.magic)) != 0) return false;
+    if (hdr.layout_hash != layout_hash() || hdr.num_blocks != blocks.size()) {
+        std::cerr << "[SHiP-RRIP+] checkpoint was taken with a different cache or SHCT layout\n";
+        return false;
+    }
+    const size_t table = blocks.size() * sizeof(uint64_t);
+    if (size < sizeof(hdr) + table) return false;
+    const uint8_t *sizes = data + sizeof(hdr);
+    size_t pos = sizeof(hdr) + table;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        uint64_t bytes;
+        memcpy(&bytes, sizes + i * sizeof(uint64_t), sizeof(bytes));
+        pos = page_round(pos);
+        if (bytes != blocks[i].second || pos + blocks[i].second > size) return false;
+        memcpy(blocks[i].first, data + pos, blocks[i].second);
+        pos += blocks[i].second;
+    }
+    policy->restored();
+    for (size_t i = 0; i < shadows.size(); i++) shadows[i]->restored();
+    return true;
+}
+
+// Side-by-side results of the main policy and its shadows. Counts cover the
+// whole run, warmup included, like Total Hits/Misses.
+static void print_shadow_table() {
+    uint64_t instrs = 0;
+    for (uint32_t c = 0; c < cfg.num_core; c++) instrs += get_instr_count(c);
+
+    char line[64];
+    std::cout << "  Shadow policies (same LLC access stream, " << instrs
+              << " instructions):\n";
+    std::cout << "            hits      misses     MPKI  policy\n";
+    for (size_t i = 0; i <= shadows.size(); i++) {
+        const ReplPolicy &p = i == 0 ? *policy : shadows[i - 1]->policy();
+        snprintf(line, sizeof(line), "%12llu%12llu%9.3f",
+                 (unsigned long long)p.stat_hits, (unsigned long long)p.stat_misses,
+                 instrs ? 1000.0 * p.stat_misses / instrs : 0.0);
+        std::cout << "    " << line << "  "
+                  << (i == 0 ? "main" : shadows[i - 1]->spec()) << "\n";
+    }
+}
+
+// Structured statistics: with $SHIP_STATS=<file>, PrintStats appends one
+// JSON object per run (JSON lines) holding the configuration, hit/miss
+// counts overall and per access type, an SHCT summary and any shadows.
+// Counts cover the whole run, warmup included.
+static std::string json_string(const std::string &str) {
+    std::string out = "\"";
+    for (size_t i = 0; i < str.size(); i++) {
+        if (str[i] == '"' || str[i] == '\\') out += '\\';
+        out += str[i];
+    }
+    return out + "\"";
+}
+
+static void write_counts(std::ostream &out, const ReplPolicy &p) {
+    out << "\"hits\":" << p.stat_hits << ",\"misses\":" << p.stat_misses
+        << ",\"bypasses\":" << p.stat_bypasses << ",\"types\":{";
+    for (uint32_t t = 0; t < ACCESS_TYPES; t++) {
+        out << (t ? "," : "") << "\"" << access_type_names[t] << "\":{\"hits\":"
+            << p.stat_type_hits[t] << ",\"misses\":" << p.stat_type_misses[t]
+            << ",\"evictions\":" << p.stat_type_evictions[t] << ",\"insert\":{";
+        for (uint32_t k = 0; k < INSERT_CLASSES; k++) {
+            out << (k ? "," : "") << "\"" << insert_class_names[k] << "\":"
+                << p.stat_type_insert[t][k];
         }
+        out << "}}";
+    }
+    out << "}";
+}
+
+static void write_stats_record(const char *path) {
+    std::ofstream out(path, std::ios::app);
+    if (!out) {
+        std::cerr << "[SHiP-RRIP+] cannot write stats to " << path << "\n";
+        return;
     }
+    uint64_t instrs = 0;
+    for (uint32_t c = 0; c < cfg.num_core; c++) instrs += get_instr_count(c);
 
-    // Compute new signature
-    uint16_t newsig = (uint32_t)(PC >> SIGN_SHIFT) & (SHCT_SIZE - 1);
-    line_sig    = newsig;
-    line_reused = 0;
+    // SHCT summary: counters never trained, predicting reuse, saturated
+    const std::vector<uint8_t> &shct = policy->shct();
+    uint64_t zero = 0, reuse = 0, saturated = 0, sum = 0;
+    for (size_t i = 0; i < shct.size(); i++) {
+        zero      += shct[i] == 0;
+        reuse     += shct[i] >= cfg.threshold;
+        saturated += shct[i] == cfg.shct_max;
+        sum       += shct[i];
+    }
+
+    out << "{\"policy\":\"SHiP-RRIP+\",\"config\":{"
+        << "\"num_core\":" << cfg.num_core << ",\"llc_sets\":" << cfg.llc_sets
+        << ",\"llc_ways\":" << cfg.llc_ways << ",\"rrpv_bits\":" << cfg.rrpv_bits
+        << ",\"shct_size\":" << cfg.shct_size << ",\"sign_shift\":" << cfg.sign_shift
+        << ",\"shct_mode\":" << cfg.shct_mode << ",\"leader_sets\":" << cfg.leader_sets
+        << ",\"shct_max\":" << cfg.shct_max << ",\"shct_init\":" << cfg.shct_init
+        << ",\"threshold\":" << cfg.threshold << ",\"wb_aware\":" << cfg.wb_aware
+        << ",\"pf_aware\":" << cfg.pf_aware << ",\"bypass\":" << cfg.bypass
+        << ",\"bypass_sample\":" << cfg.bypass_sample << "}"
+        << ",\"specialized\":" << (policy->specialized() ? "true" : "false")
+        << ",\"instructions\":" << instrs << ",\"cycles\":" << get_cycle_count()
+        << ",\"mpki_incl_warmup\":" << (instrs ? 1000.0 * policy->stat_misses / instrs : 0.0)
+        << ",\"warmup\":{\"instructions\":" << warmup_end.instrs
+        << ",\"cycles\":" << warmup_end.cycles << ",\"misses\":" << warmup_end.misses << "}"
+        << ",\"mpki\":" << (instrs > warmup_end.instrs ? 1000.0 * (policy->stat_misses - warmup_end.misses) /
+                                                      (instrs - warmup_end.instrs) : 0.0) << ",";
+    write_counts(out, *policy);
+    out << ",\"shct\":{\"entries\":" << shct.size() << ",\"zero\":" << zero
+        << ",\"predict_reuse\":" << reuse << ",\"saturated\":" << saturated
+        << ",\"mean\":" << (shct.empty() ? 0.0 : (double)sum / shct.size()) << "}";
+    out << ",\"shadows\":[";
+    for (size_t i = 0; i < shadows.size(); i++) {
+        out << (i ? "," : "") << "{\"spec\":" << json_string(shadows[i]->spec()) << ",";
+        write_counts(out, shadows[i]->policy());
+        out << "}";
+    }
+    out << "]}\n";
+}
 
-    // Adaptive insertion policy
-    uint8_t pred = SHCT[newsig];
-    if (pred >= (uint8_t)(THRESHOLD + 2)) {
-        line_rrpv = 0;
-    } else if (pred >= (uint8_t)THRESHOLD) {
-        line_rrpv = 1;
-    } else if (pred > 0) {
-        line_rrpv = (MAX_RRPV >= 2) ? MAX_RRPV - 1 : MAX_RRPV;
-    } else {
-        line_rrpv = MAX_RRPV;
+// Hits, misses, evictions caused and insertion mix for each access type
+static void print_type_table() {
+    char line[160];
+    std::cout << "  By type          hits      misses   evictions  insert mru/near/far/distant\n";
+    for (uint32_t t = 0; t < ACCESS_TYPES; t++) {
+        const uint64_t *ins = policy->stat_type_insert[t];
+        snprintf(line, sizeof(line), "    %-9s %12llu%12llu%12llu  %llu/%llu/%llu/%llu",
+                 access_type_names[t], (unsigned long long)policy->stat_type_hits[t],
+                 (unsigned long long)policy->stat_type_misses[t],
+                 (unsigned long long)policy->stat_type_evictions[t],
+                 (unsigned long long)ins[0], (unsigned long long)ins[1],
+                 (unsigned long long)ins[2], (unsigned long long)ins[3]);
+        std::cout << line << "\n";
     }
 }
 
 // Print end-of-simulation statistics
 void PrintStats() {
     std::cout << "=== SHiP-RRIP+ Statistics ===\n";
-    std::cout << "  Total Hits    : " << stat_hits   << "\n";
-    std::cout << "  Total Misses  : " << stat_misses << "\n";
+    std::cout << "  Total Hits    : " << policy->stat_hits   << "\n";
+    std::cout << "  Total Misses  : " << policy->stat_misses << "\n";
+    if (cfg.bypass) {
+        std::cout << "  Bypasses      : " << policy->stat_bypasses << "\n";
+    }
+    print_type_table();
+    policy->print_storage();
+#ifdef SHIP_PRED_STATS
+    policy->print_prediction_stats();
+#endif
+#ifdef SHIP_PC_STATS
+    pc_stats.print();
+#endif
+#ifdef SHIP_RD_STATS
+    rd_stats.print();
+#endif
+    if (!shadows.empty()) print_shadow_table();
+    const char *stats_path = getenv("SHIP_STATS");
+    if (stats_path && *stats_path) write_stats_record(stats_path);
+    close_heartbeat_log();
+    capture.close();
 }
 
 // Print heartbeat (called periodically during simulation)
 void PrintStats_Heartbeat() {
-    // A lightweight summary
-    std::cout << "[Heartbeat] Hits: " << stat_hits
-              << "  Misses: " << stat_misses << std::endl;
+    HeartbeatSnapshot now;
+    for (uint32_t c = 0; c < cfg.num_core; c++) now.instrs += get_instr_count(c);
+    now.hits   = policy->stat_hits;
+    now.misses = policy->stat_misses;
+    memcpy(now.type_hits, policy->stat_type_hits, sizeof(now.type_hits));
+    memcpy(now.type_misses, policy->stat_type_misses, sizeof(now.type_misses));
+    for (uint32_t t = 0; t < ACCESS_TYPES; t++) {
+        for (uint32_t k = 0; k < INSERT_CLASSES; k++) {
+            now.insert[k] += policy->stat_type_insert[t][k];
+        }
+    }
+
+    const uint64_t instrs   = now.instrs - last_heartbeat.instrs;
+    const uint64_t hits     = now.hits - last_heartbeat.hits;
+    const uint64_t misses   = now.misses - last_heartbeat.misses;
+    const double   hit_rate = hits + misses ? (double)hits / (hits + misses) : 0.0;
+    const double   mpki     = instrs ? 1000.0 * misses / instrs : 0.0;
+    uint64_t       type_hits[ACCESS_TYPES], type_misses[ACCESS_TYPES];
+    for (uint32_t t = 0; t < ACCESS_TYPES; t++) {
+        type_hits[t]   = now.type_hits[t] - last_heartbeat.type_hits[t];
+        type_misses[t] = now.type_misses[t] - last_heartbeat.type_misses[t];
+    }
+    // Demand (LOAD + RFO) misses are what IPC follows
+    const double demand_mpki =
+        instrs ? 1000.0 * (type_misses[0] + type_misses[1]) / instrs : 0.0;
+
+    const std::vector<uint8_t> &shct = policy->shct();
+    uint64_t saturated = 0;
+    for (size_t i = 0; i < shct.size(); i++) saturated += shct[i] == cfg.shct_max;
+    const double sat = shct.empty() ? 0.0 : (double)saturated / shct.size();
+
+    uint64_t inserts = 0;
+    double   mix[INSERT_CLASSES];
+    for (uint32_t k = 0; k < INSERT_CLASSES; k++) {
+        inserts += now.insert[k] - last_heartbeat.insert[k];
+    }
+    for (uint32_t k = 0; k < INSERT_CLASSES; k++) {
+        mix[k] = inserts ? (double)(now.insert[k] - last_heartbeat.insert[k]) / inserts : 0.0;
+    }
+
+    char line[256];
+    snprintf(line, sizeof(line),
+             "[Heartbeat] Hits: %llu  Misses: %llu  Interval: hit rate %.3f, MPKI %.3f"
+             " (demand %.3f), SHCT saturated %.3f, insert mru/near/far/distant"
+             " %.2f/%.2f/%.2f/%.2f\n",
+             (unsigned long long)now.hits, (unsigned long long)now.misses,
+             hit_rate, mpki, demand_mpki, sat, mix[0], mix[1], mix[2], mix[3]);
+    std::cout << line;
+
+    if (heartbeat_log) {
+        fprintf(heartbeat_log,
+                "{\"seq\":%llu,\"cycle\":%llu,\"instructions\":%llu,\"hits\":%llu,"
+                "\"misses\":%llu,\"hit_rate\":%.6f,\"mpki\":%.6f,\"demand_mpki\":%.6f,"
+                "\"shct_saturated\":%.6f,\"insert\":{",
+                (unsigned long long)heartbeat_seq, (unsigned long long)get_cycle_count(),
+                (unsigned long long)instrs, (unsigned long long)hits,
+                (unsigned long long)misses, hit_rate, mpki, demand_mpki, sat);
+        for (uint32_t k = 0; k < INSERT_CLASSES; k++) {
+            fprintf(heartbeat_log, "%s\"%s\":%.6f", k ? "," : "", insert_class_names[k], mix[k]);
+        }
+        fputs("},\"types\":{", heartbeat_log);
+        for (uint32_t t = 0; t < ACCESS_TYPES; t++) {
+            fprintf(heartbeat_log, "%s\"%s\":{\"hits\":%llu,\"misses\":%llu}", t ? "," : "",
+                    access_type_names[t], (unsigned long long)type_hits[t],
+                    (unsigned long long)type_misses[t]);
+        }
+        fputs("}}\n", heartbeat_log);
+    }
+    heartbeat_seq++;
+    last_heartbeat = now;
 }
@@ -0,0 +1,385 @@
+// Policy-only LLC simulation. Replays a recorded LLC access stream (see
+// llc_trace.h) through a minimal tag array and the CRC2 replacement
+// interface of the policy it is linked with:
+//
+//   g++ -std=c++11 -O2 -pthread -Iinc new_policy.cc replay.cc -o replay_bin
+//   ./replay_bin --warmup_instructions 200000000 results/mcf.llc.gz
+//
+// Only the LLC is modelled, so hit/miss counts and MPKI are exact for the
+// recorded stream while IPC is not available.
+//
+// --checkpoint_out saves the tag array and policy state once every core has
+// finished warmup; --checkpoint_in restores it and skips the warmup records
+// without simulating them, so variants sharing a warmup pay for it once.
+
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../inc/champsim_crc2.h"
+#include "llc_trace.h"
+
+static const uint32_t LOG2_BLOCK_SIZE = 6;
+static const uint64_t HEARTBEAT_INSTR = 10000000;
+static const uint64_t INVALID_TAG     = ~(uint64_t)0;
+
+// Replay progress, exposed to the policy through the CRC2 helpers. There is
+// no timing model, so the cycle count is the number of accesses replayed.
+static std::vector<uint64_t> instr_count;
+static uint64_t              cycle_count;
+
+uint64_t get_cycle_count() { return cycle_count; }
+uint64_t get_instr_count(uint32_t cpu) { return instr_count[cpu]; }
+
+static bool ends_with(const std::string &s, const char *suffix) {
+    size_t n = strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// Open a stream, decompressing .gz/.xz through a pipe like ChampSim traces
+static FILE *open_stream(const std::string &path, bool &piped) {
+    const char *cmd = ends_with(path, ".gz") ? "gzip -dc '" :
+                      ends_with(path, ".xz") ? "xz -dc '"   : NULL;
+    piped = cmd != NULL;
+    if (!piped) return fopen(path.c_str(), "rb");
+    return popen((std::string(cmd) + path + "'").c_str(), "r");
+}
+
+static void usage(const char *argv0) {
+    std::cerr << "usage: " << argv0 << " [--warmup_instructions N]"
+              << " [--simulation_instructions N] [--set key=value]..."
+              << " [--checkpoint_out file | --checkpoint_in file] stream\n"
+              << "  --set passes a policy parameter as SHIP_<KEY>=value\n";
+    exit(EXIT_FAILURE);
+}
+
+// Export key=value as SHIP_<KEY> for the policy's load_config()
+static void set_policy_param(const std::string &kv, int overwrite) {
+    size_t eq = kv.find('=');
+    if (eq == std::string::npos) {
+        std::cerr << "[replay] expected key=value, got " << kv << "\n";
+        exit(EXIT_FAILURE);
+    }
+    std::string var = "SHIP_";
+    for (size_t i = 0; i < eq; i++) var += (char)toupper(kv[i]);
+    setenv(var.c_str(), kv.c_str() + eq + 1, overwrite);
+}
+
+static uint32_t env_u32(const char *var) {
+    return (uint32_t)strtoul(getenv(var), NULL, 0);
+}
+
+// Everything the replay loop carries from one record to the next. A
+// checkpoint is this state at the first record past warmup, followed by the
+// policy's own section at a page-aligned offset.
+struct ReplayState {
+    uint32_t num_core, sets, ways;
+    uint64_t warmup;
+    uint64_t consumed = 0;       // stream records read so far
+    uint64_t accesses = 0, hits = 0, misses = 0, bypasses = 0;
+    uint64_t next_heartbeat = HEARTBEAT_INSTR;
+    uint32_t cores_measuring = 0, cores_done = 0;
+    std::vector<uint64_t> tags;
+    std::vector<uint64_t> measure_start, measure_end;
+    std::vector<uint8_t>  measuring, done;
+};
+
+static const char CKPT_REPLAY_MAGIC[8] = { 'L', 'L', 'C', 'C', 'K', 'P', 'T', '2' };
+
+struct ReplayCheckpointHeader {
+    char     magic[8];
+    uint32_t num_core, sets, ways, cores_measuring, cores_done, reserved;
+    uint64_t warmup, consumed, cycle_count;
+    uint64_t accesses, hits, misses, bypasses, next_heartbeat;
+    uint64_t policy_offset;
+};
+
+static void save_checkpoint(const std::string &path, const ReplayState &st) {
+    ReplayCheckpointHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, CKPT_REPLAY_MAGIC, sizeof(hdr.magic));
+    hdr.num_core        = st.num_core;
+    hdr.sets            = st.sets;
+    hdr.ways            = st.ways;
+    hdr.cores_measuring = st.cores_measuring;
+    hdr.cores_done      = st.cores_done;
+    hdr.warmup          = st.warmup;
+    hdr.consumed        = st.consumed;
+    hdr.cycle_count     = cycle_count;
+    hdr.accesses        = st.accesses;
+    hdr.hits            = st.hits;
+    hdr.misses          = st.misses;
+    hdr.bypasses        = st.bypasses;
+    hdr.next_heartbeat  = st.next_heartbeat;
+    const size_t driver_bytes = sizeof(hdr) + st.num_core * (3 * sizeof(uint64_t) + 2) +
+                                st.tags.size() * sizeof(uint64_t);
+    hdr.policy_offset = (driver_bytes + CKPT_PAGE_SIZE - 1) & ~(CKPT_PAGE_SIZE - 1);
+
+    FILE *out = fopen(path.c_str(), "wb");
+    bool  ok  = out != NULL &&
+        fwrite(&hdr, sizeof(hdr), 1, out) == 1 &&
+        fwrite(instr_count.data(), sizeof(uint64_t), st.num_core, out) == st.num_core &&
+        fwrite(st.measure_start.data(), sizeof(uint64_t), st.num_core, out) == st.num_core &&
+        fwrite(st.measure_end.data(), sizeof(uint64_t), st.num_core, out) == st.num_core &&
+        fwrite(st.measuring.data(), 1, st.num_core, out) == st.num_core &&
+        fwrite(st.done.data(), 1, st.num_core, out) == st.num_core &&
+        fwrite(st.tags.data(), sizeof(uint64_t), st.tags.size(), out) == st.tags.size();
+    if (ok) {
+        static const char zeros[CKPT_PAGE_SIZE] = {};
+        const size_t pad = hdr.policy_offset - driver_bytes;
+        ok = fwrite(zeros, 1, pad, out) == pad && SaveReplacementState(out);
+    }
+    if (out && fclose(out) != 0) ok = false;
+    if (!ok) {
+        std::cerr << "[replay] cannot write checkpoint " << path << "\n";
+        exit(EXIT_FAILURE);
+    }
+    std::cout << "[replay] checkpoint after " << st.consumed << " records -> " << path << "\n";
+}
+
+static void load_checkpoint(const std::string &path, ReplayState &st) {
+    int         fd = open(path.c_str(), O_RDONLY);
+    struct stat sb;
+    void       *map = MAP_FAILED;
+    if (fd >= 0 && fstat(fd, &sb) == 0 && sb.st_size > 0) {
+        map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    if (fd >= 0) close(fd);
+    if (map == MAP_FAILED) {
+        std::cerr << "[replay] cannot map checkpoint " << path << "\n";
+        exit(EXIT_FAILURE);
+    }
+    const uint8_t *data = (const uint8_t *)map;
+    const size_t   size = (size_t)sb.st_size;
+
+    ReplayCheckpointHeader hdr;
+    if (size < sizeof(hdr)) memset(&hdr, 0, sizeof(hdr));
+    else memcpy(&hdr, data, sizeof(hdr));
+    if (memcmp(hdr.magic, CKPT_REPLAY_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.policy_offset > size) {
+        std::cerr << "[replay] " << path << " is not a replay checkpoint\n";
+        exit(EXIT_FAILURE);
+    }
+    if (hdr.num_core != st.num_core || hdr.sets != st.sets || hdr.ways != st.ways ||
+        hdr.warmup != st.warmup) {
+        std::cerr << "[replay] checkpoint " << path << " was taken with a different"
+                  << " geometry or warmup length\n";
+        exit(EXIT_FAILURE);
+    }
+
+    const uint8_t *p = data + sizeof(hdr);
+    memcpy(instr_count.data(), p, st.num_core * sizeof(uint64_t));
+    p += st.num_core * sizeof(uint64_t);
+    memcpy(st.measure_start.data(), p, st.num_core * sizeof(uint64_t));
+    p += st.num_core * sizeof(uint64_t);
+    memcpy(st.measure_end.data(), p, st.num_core * sizeof(uint64_t));
+    p += st.num_core * sizeof(uint64_t);
+    memcpy(st.measuring.data(), p, st.num_core);
+    p += st.num_core;
+    memcpy(st.done.data(), p, st.num_core);
+    p += st.num_core;
+    memcpy(st.tags.data(), p, st.tags.size() * sizeof(uint64_t));
+
+    if (!LoadReplacementState(data + hdr.policy_offset, size - hdr.policy_offset)) {
+        std::cerr << "[replay] checkpoint " << path << " does not match the policy\n";
+        exit(EXIT_FAILURE);
+    }
+    munmap(map, size);
+
+    st.consumed        = hdr.consumed;
+    st.cores_measuring = hdr.cores_measuring;
+    st.cores_done      = hdr.cores_done;
+    st.accesses        = hdr.accesses;
+    st.hits            = hdr.hits;
+    st.misses          = hdr.misses;
+    st.bypasses        = hdr.bypasses;
+    st.next_heartbeat  = hdr.next_heartbeat;
+    cycle_count        = hdr.cycle_count;
+}
+
+// Drop the first n records of the stream; pipes cannot seek
+static bool skip_records(FILE *in, bool piped, uint64_t n) {
+    if (!piped) return fseeko(in, (off_t)(n * sizeof(LlcAccess)), SEEK_CUR) == 0;
+    std::vector<LlcAccess> buf(4096);
+    while (n > 0) {
+        size_t want = n < buf.size() ? (size_t)n : buf.size();
+        if (fread(buf.data(), sizeof(LlcAccess), want, in) != want) return false;
+        n -= want;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    uint64_t    warmup = 0, sim = UINT64_MAX;
+    std::string path, ckpt_in, ckpt_out;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--warmup_instructions" && i + 1 < argc) {
+            warmup = strtoull(argv[++i], NULL, 0);
+        } else if (arg == "--simulation_instructions" && i + 1 < argc) {
+            sim = strtoull(argv[++i], NULL, 0);
+        } else if (arg == "--set" && i + 1 < argc) {
+            set_policy_param(argv[++i], 1);
+        } else if (arg == "--checkpoint_in" && i + 1 < argc) {
+            ckpt_in = argv[++i];
+        } else if (arg == "--checkpoint_out" && i + 1 < argc) {
+            ckpt_out = argv[++i];
+        } else if (arg[0] != '-' && path.empty()) {
+            path = arg;
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (path.empty() || (!ckpt_in.empty() && !ckpt_out.empty())) usage(argv[0]);
+
+    bool  piped;
+    FILE *in = open_stream(path, piped);
+    LlcTraceHeader hdr;
+    if (!in || fread(&hdr, sizeof(hdr), 1, in) != 1 || !llc_trace_magic_ok(hdr)) {
+        std::cerr << "[replay] " << path << " is not an LLC access stream\n";
+        return EXIT_FAILURE;
+    }
+
+    // The recorded geometry is the default; --set may override it
+    set_policy_param("num_core=" + std::to_string(hdr.num_core), 0);
+    set_policy_param("llc_sets=" + std::to_string(hdr.llc_sets), 0);
+    set_policy_param("llc_ways=" + std::to_string(hdr.llc_ways), 0);
+    // The stats record splits off warmup at the same point as the replay
+    set_policy_param("warmup=" + std::to_string(warmup), 1);
+    ReplayState st;
+    st.num_core = env_u32("SHIP_NUM_CORE");
+    st.sets     = env_u32("SHIP_LLC_SETS");
+    st.ways     = env_u32("SHIP_LLC_WAYS");
+    st.warmup   = warmup;
+    st.tags.assign((size_t)st.sets * st.ways, INVALID_TAG);
+    st.measure_start.assign(st.num_core, 0);
+    st.measure_end.assign(st.num_core, 0);
+    st.measuring.assign(st.num_core, 0);
+    st.done.assign(st.num_core, 0);
+    instr_count.assign(st.num_core, 0);
+
+    const uint32_t num_core  = st.num_core;
+    const uint32_t sets      = st.sets;
+    const uint32_t ways      = st.ways;
+    const bool     same_sets = sets == hdr.llc_sets;
+    std::vector<BLOCK> blocks((size_t)sets * ways);
+
+    InitReplacementState();
+
+    if (!ckpt_in.empty()) {
+        load_checkpoint(ckpt_in, st);
+        for (size_t i = 0; i < st.tags.size(); i++) {
+            if (st.tags[i] == INVALID_TAG) continue;
+            blocks[i].valid     = 1;
+            blocks[i].tag       = st.tags[i];
+            blocks[i].address   = st.tags[i];
+            blocks[i].full_addr = st.tags[i] << LOG2_BLOCK_SIZE;
+        }
+        if (!skip_records(in, piped, st.consumed)) {
+            std::cerr << "[replay] " << path << " is shorter than checkpoint " << ckpt_in << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    bool ckpt_pending = !ckpt_out.empty();
+    std::vector<LlcAccess> buf(4096);
+
+    auto t0 = std::chrono::steady_clock::now();
+    size_t n;
+    while (st.cores_done < num_core &&
+           (n = fread(buf.data(), sizeof(LlcAccess), buf.size(), in)) > 0) {
+        for (size_t i = 0; i < n; i++, st.consumed++) {
+            const LlcAccess &a = buf[i];
+            const uint32_t cpu   = a.cpu;
+            const uint64_t block = a.paddr >> LOG2_BLOCK_SIZE;
+            const uint32_t set   = same_sets ? a.set : (uint32_t)(block % sets);
+            if (cpu >= num_core) continue;
+
+            if (!st.measuring[cpu] && a.instr >= warmup) {
+                // Checkpoint just before the last core leaves warmup
+                if (ckpt_pending && st.cores_measuring + 1 == num_core) {
+                    save_checkpoint(ckpt_out, st);
+                    ckpt_pending = false;
+                }
+                st.measuring[cpu]     = 1;
+                st.measure_start[cpu] = a.instr;
+                st.cores_measuring++;
+            }
+            instr_count[cpu] = a.instr;
+            cycle_count++;
+            if (st.measuring[cpu] && !st.done[cpu] && a.instr - st.measure_start[cpu] >= sim) {
+                st.done[cpu]        = 1;
+                st.measure_end[cpu] = a.instr;
+                // Stop at the end of the window, not at the end of the buffer
+                if (++st.cores_done == num_core) break;
+            }
+            if (cpu == 0 && a.instr >= st.next_heartbeat) {
+                PrintStats_Heartbeat();
+                st.next_heartbeat += HEARTBEAT_INSTR;
+            }
+
+            uint64_t *set_tags = &st.tags[(size_t)set * ways];
+            BLOCK    *set_blks = &blocks[(size_t)set * ways];
+            uint32_t  way = 0;
+            while (way < ways && set_tags[way] != block) way++;
+
+            const bool count = st.measuring[cpu] && !st.done[cpu];
+            st.accesses += count;
+            if (way < ways) {
+                st.hits += count;
+                UpdateReplacementState(cpu, set, way, a.paddr, a.pc, 0, a.type, 1);
+                continue;
+            }
+
+            st.misses += count;
+            way = GetVictimInSet(cpu, set, set_blks, a.pc, a.paddr, a.type);
+            if (way >= ways) {
+                st.bypasses += count;
+                UpdateReplacementState(cpu, set, ways, a.paddr, a.pc, 0, a.type, 0);
+                continue;
+            }
+            const uint64_t victim_addr =
+                set_tags[way] == INVALID_TAG ? 0 : set_tags[way] << LOG2_BLOCK_SIZE;
+            set_tags[way]           = block;
+            set_blks[way].valid     = 1;
+            set_blks[way].tag       = block;
+            set_blks[way].address   = block;
+            set_blks[way].full_addr = a.paddr;
+            set_blks[way].cpu       = cpu;
+            UpdateReplacementState(cpu, set, way, a.paddr, a.pc, victim_addr, a.type, 0);
+        }
+    }
+    if (ckpt_pending) {
+        std::cerr << "[replay] stream ended before warmup; no checkpoint written\n";
+    }
+    const double secs = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+    if (piped) pclose(in); else fclose(in);
+
+    uint64_t instrs = 0;
+    for (uint32_t c = 0; c < num_core; c++) {
+        if (st.measuring[c])
+            instrs += (st.done[c] ? st.measure_end[c] : instr_count[c]) - st.measure_start[c];
+    }
+
+    std::cout << "=== LLC replay: " << path << " ===\n";
+    std::cout << "  Accesses      : " << st.accesses << "\n";
+    std::cout << "  Hits          : " << st.hits     << "\n";
+    std::cout << "  Misses        : " << st.misses   << "\n";
+    std::cout << "  Bypasses      : " << st.bypasses << "\n";
+    std::cout << "  Instructions  : " << instrs      << "\n";
+    std::cout << "  LLC MPKI      : "
+              << (instrs ? 1000.0 * st.misses / instrs : 0.0) << "\n";
+    std::cout << "  Replay time   : " << secs << " s ("
+              << (secs > 0 ? cycle_count / secs / 1e6 : 0.0) << " M accesses/s)\n";
+    PrintStats();
+    return 0;
+}
@@ -12,9 +12,11 @@ POLICY_DIR="champ_repl_pol"
 BASELINE_SRC="${POLICY_DIR}/015_ship_rrip__signature_based_hit_predictor_with_srrip.cc"
 NEW_SRC="${POLICY_DIR}/new_policy.cc"
 HELPER_SRC="${POLICY_DIR}/lru.cc"    # driver/main used by CRC2 builds
+REPLAY_SRC="${POLICY_DIR}/replay.cc" # policy-only LLC replay driver
 
 BASELINE_BIN="baseline_bin"
 NEW_BIN="new_policy_bin"
+REPLAY_BIN="replay_bin"
 RESULTS_DIR="results"
 mkdir -p "$RESULTS_DIR"
 
@@ -31,17 +33,27 @@ TRACES=(
 WARMUP=200000000
 SIM=1000000000
 
+# Finished runs are cached under results/cache, keyed by a hash of everything
+# that determines their output; set NO_CACHE=1 to always re-simulate
+CACHE_DIR="${RESULTS_DIR}/cache"
+NO_CACHE="${NO_CACHE:-0}"
+mkdir -p "$CACHE_DIR"
+
+# Set CAPTURE=1 to record each trace's LLC access stream during the new
+# policy run (results/<trace>.llc.gz), for later runs of replay_bin
+CAPTURE="${CAPTURE:-0}"
+
 # ----- Compiler selection -----
 OS="$(uname -s)"
 if [[ "$OS" == "Darwin" ]]; then
   # macOS (Apple Silicon)
   SDK_PATH="$(xcrun --show-sdk-path)"
   CXX="clang++"
-  CXXFLAGS="-std=c++11 -stdlib=libc++ -Wall -O2 -isysroot ${SDK_PATH} -I${INC_DIR}"
+  CXXFLAGS="-std=c++11 -stdlib=libc++ -Wall -O2 -pthread -isysroot ${SDK_PATH} -I${INC_DIR}"
 else
   # Linux
   CXX="g++"
-  CXXFLAGS="-std=c++11 -Wall -O2 -I${INC_DIR}"
+  CXXFLAGS="-std=c++11 -Wall -O2 -pthread -I${INC_DIR}"
 fi
 
 echo "Using compiler: $CXX"
@@ -62,29 +74,154 @@ compile_policy() {
 # ----- Compile baseline and new policy -----
 compile_policy "$BASELINE_SRC" "$BASELINE_BIN"
 compile_policy "$NEW_SRC" "$NEW_BIN"
+if [ -f "$REPLAY_SRC" ]; then
+  $CXX $CXXFLAGS "$NEW_SRC" "$REPLAY_SRC" -o "$REPLAY_BIN" || echo "Compilation failed for $REPLAY_SRC"
+fi
 
 # ----- Run experiments -----
-echo "trace,policy,ipc,mpki,raw_output_file" > "${RESULTS_DIR}/summary.csv"
+# One job per trace x policy, JOBS at a time (default: all cores). Each job
+# writes its own summary row; rows are merged in a fixed order at the end.
+JOBS="${JOBS:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 1)}"
+ROWS_DIR="${RESULTS_DIR}/rows"
+rm -rf "$ROWS_DIR"
+mkdir -p "$ROWS_DIR"
+
+sha256() {
+  if command -v sha256sum >/dev/null 2>&1; then sha256sum; else shasum -a 256; fi | cut -d' ' -f1
+}
+
+# Result cache key: policy source, compiler and flags, simulator binary,
+# trace identity (name, size, mtime - hashing multi-GB traces per run would
+# cost more than it saves), run lengths and, for the new policy, its SHIP_*
+# runtime parameters
+cache_key() {
+  local TRACE="$1" BIN="$2" SRC="$3" MTIME
+  MTIME=$(stat -c %Y "$TRACE" 2>/dev/null || stat -f %m "$TRACE")
+  {
+    echo "src $(sha256 < "$SRC")"
+    echo "cxx $CXX $CXXFLAGS"
+    echo "bin $(sha256 < "$BIN")"
+    echo "trace $(basename "$TRACE") $(wc -c < "$TRACE" | tr -d ' ') $MTIME"
+    echo "run $WARMUP $SIM"
+    if [[ "$SRC" == "$NEW_SRC" ]]; then
+      env | grep '^SHIP_' | sort || true
+      if [ -n "${SHIP_CONFIG:-}" ] && [ -f "$SHIP_CONFIG" ]; then sha256 < "$SHIP_CONFIG"; fi
+    fi
+  } | sha256
+}
+
+run_job() {
+  local TRACE="$1"
+  local BIN="$2"
+  local LABEL OUTFILE STATS_FILE CAPTURE_FILE IPC MPKI SRC KEY
+  LABEL=$(basename "$BIN")
+  OUTFILE="${RESULTS_DIR}/$(basename ${TRACE}).${LABEL}.out"
+  # The new policy writes a JSON stats record (SHIP_STATS) next to its output
+  STATS_FILE=""
+  if [[ "$BIN" == "$NEW_BIN" ]]; then
+    STATS_FILE="${RESULTS_DIR}/$(basename ${TRACE}).${LABEL}.stats.json"
+    rm -f "$STATS_FILE"
+  fi
+  CAPTURE_FILE=""
+  if [[ "$CAPTURE" == "1" && "$BIN" == "$NEW_BIN" ]]; then
+    CAPTURE_FILE="${RESULTS_DIR}/$(basename "$TRACE" .champsimtrace.gz).llc.gz"
+  fi
+  SRC="$NEW_SRC"
+  if [[ "$BIN" == "$BASELINE_BIN" ]]; then SRC="$BASELINE_SRC"; fi
+  KEY=$(cache_key "$TRACE" "$BIN" "$SRC")
+
+  # Capture runs always simulate, since the stream is a side effect
+  if [[ "$NO_CACHE" != "1" && -z "$CAPTURE_FILE" && -f "${CACHE_DIR}/${KEY}.out" ]]; then
+    echo "Cached  $BIN on $TRACE -> $OUTFILE"
+    cp "${CACHE_DIR}/${KEY}.out" "$OUTFILE"
+    if [ -n "$STATS_FILE" ] && [ -f "${CACHE_DIR}/${KEY}.stats.json" ]; then
+      cp "${CACHE_DIR}/${KEY}.stats.json" "$STATS_FILE"
+    fi
+  else
+    echo "Running $BIN on $TRACE -> $OUTFILE"
+    SHIP_CAPTURE="$CAPTURE_FILE" SHIP_STATS="$STATS_FILE" SHIP_WARMUP="$WARMUP" ./"$BIN" --warmup_instructions $WARMUP --simulation_instructions $SIM "$TRACE" > "$OUTFILE" 2>&1 || true
+    # Only completed runs are cached
+    if grep -qi "CPU 0 cumulative IPC" "$OUTFILE" 2>/dev/null; then
+      if [ -n "$STATS_FILE" ] && [ -f "$STATS_FILE" ]; then
+        cp "$STATS_FILE" "${CACHE_DIR}/${KEY}.stats.json"
+      fi
+      cp "$OUTFILE" "${CACHE_DIR}/${KEY}.out.tmp.$$" && mv "${CACHE_DIR}/${KEY}.out.tmp.$$" "${CACHE_DIR}/${KEY}.out"
+    fi
+  fi
+
+  # Extract IPC - expects a line like "CPU 0 cumulative IPC: 1.72"
+  IPC=$(grep -i "CPU 0 cumulative IPC" "$OUTFILE" 2>/dev/null | awk -F: '{print $2}' | tr -d ' ' | tr -d '\r' | head -n1 || echo "NA")
+
+  # Extract MPKI or LLC misses per 1000 instr - try two common formats:
+  MPKI=$(grep -i -E "LLC misses per 1000 instructions|LLC misses per 1000 instr|LLC TOTAL MPKI" "$OUTFILE" 2>/dev/null | awk -F: '{print $2}' | tr -d ' ' | tr -d '\r' | head -n1 || echo "NA")
+  if [ -z "$IPC" ] || [ -z "$MPKI" ]; then
+    echo "Warning: could not parse IPC/MPKI from $OUTFILE" >&2
+  fi
+  IPC="${IPC:-NA}"
+  MPKI="${MPKI:-NA}"
+
+  echo "$(basename $TRACE),${LABEL},${IPC},${MPKI},${OUTFILE}" > "${ROWS_DIR}/$(basename ${TRACE}).${LABEL}.csv"
+  echo "Finished $BIN on $TRACE"
+}
+export -f sha256 cache_key run_job
+export RESULTS_DIR ROWS_DIR CACHE_DIR NO_CACHE WARMUP SIM CAPTURE CXX CXXFLAGS
+export BASELINE_BIN NEW_BIN BASELINE_SRC NEW_SRC
+
+# Queue the matrix longest job first, using trace size as the estimate
 for TRACE in "${TRACES[@]}"; do
   if [ ! -f "$TRACE" ]; then
-    echo "Warning: trace $TRACE not found - skipping"
+    echo "Warning: trace $TRACE not found - skipping" >&2
     continue
   fi
-
+  SIZE=$(wc -c < "$TRACE" | tr -d ' ')
   for BIN in "$BASELINE_BIN" "$NEW_BIN"; do
-    LABEL=$(basename "$BIN")
-    OUTFILE="${RESULTS_DIR}/$(basename ${TRACE}).${LABEL}.out"
-    echo "Running $BIN on $TRACE -> $OUTFILE"
-    ./"$BIN" --warmup_instructions $WARMUP --simulation_instructions $SIM "$TRACE" > "$OUTFILE" 2>&1 || true
-
-    # Extract IPC - expects a line like "CPU 0 cumulative IPC: 1.72"
-    IPC=$(grep -i "CPU 0 cumulative IPC" "$OUTFILE" 2>/dev/null | awk -F: '{print $2}' | tr -d ' ' | tr -d '\r' | head -n1 || echo "NA")
-
-    # Extract MPKI or LLC misses per 1000 instr - try two common formats:
-    MPKI=$(grep -i -E "LLC misses per 1000 instructions|LLC misses per 1000 instr|LLC TOTAL MPKI" "$OUTFILE" 2>/dev/null | awk -F: '{print $2}' | tr -d ' ' | tr -d '\r' | head -n1 || echo "NA")
+    echo "$SIZE $TRACE $BIN"
+  done
+done | sort -s -rn -k1,1 | cut -d' ' -f2- | xargs -n 2 -P "$JOBS" bash -c 'run_job "$1" "$2"' _ || true
 
-    echo "$(basename $TRACE),${LABEL},${IPC},${MPKI},${OUTFILE}" >> "${RESULTS_DIR}/summary.csv"
+# Collect rows in trace order, baseline before new policy
+echo "trace,policy,ipc,mpki,raw_output_file" > "${RESULTS_DIR}/summary.csv"
+for TRACE in "${TRACES[@]}"; do
+  for BIN in "$BASELINE_BIN" "$NEW_BIN"; do
+    ROW="${ROWS_DIR}/$(basename ${TRACE}).$(basename "$BIN").csv"
+    if [ -f "$ROW" ]; then
+      cat "$ROW" >> "${RESULTS_DIR}/summary.csv"
+    fi
   done
 done
 
+# Collect the new policy's JSON stats records into one table
+STATS_CSV="${RESULTS_DIR}/policy_stats.csv"
+STATS_FILES=()
+for TRACE in "${TRACES[@]}"; do
+  F="${RESULTS_DIR}/$(basename ${TRACE}).$(basename "$NEW_BIN").stats.json"
+  if [ -f "$F" ]; then STATS_FILES+=("$F"); fi
+done
+if [ ${#STATS_FILES[@]} -gt 0 ] && command -v python3 >/dev/null 2>&1; then
+  python3 - "$STATS_CSV" "${STATS_FILES[@]}" <<'PY'
+import csv, json, os, sys
+types = ["LOAD", "RFO", "PREFETCH", "WRITEBACK"]
+with open(sys.argv[1], "w", newline="") as out:
+    w = csv.writer(out)
+    w.writerow(["trace", "instructions", "ipc", "hits", "misses", "mpki", "mpki_incl_warmup"] +
+               ["%s_%s" % (t.lower(), k) for t in types for k in ("hits", "misses")] +
+               ["shct_zero", "shct_predict_reuse", "shct_saturated", "shct_mean", "config"])
+    for path in sys.argv[2:]:
+        with open(path) as f:
+            lines = [l for l in f if l.strip()]
+        r = json.loads(lines[-1])
+        c = r["config"]
+        # Throughput over all cores past warmup, from the record's counters
+        wu = r["warmup"]
+        cycles = r["cycles"] - wu["cycles"]
+        ipc = "%.4f" % ((r["instructions"] - wu["instructions"]) / float(cycles)) if cycles > 0 else "NA"
+        w.writerow([os.path.basename(path).split(".champsimtrace")[0], r["instructions"], ipc,
+                    r["hits"], r["misses"], r["mpki"], r["mpki_incl_warmup"]] +
+                   [r["types"][t][k] for t in types for k in ("hits", "misses")] +
+                   [r["shct"]["zero"], r["shct"]["predict_reuse"], r["shct"]["saturated"],
+                    r["shct"]["mean"], " ".join("%s=%s" % kv for kv in sorted(c.items()))])
+PY
+  echo "Policy stats in ${STATS_CSV}"
+fi
+
 echo "Done. Results in ${RESULTS_DIR}/summary.csv"
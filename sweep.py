@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Parameter sweep for SHiP-RRIP+ over recorded LLC access streams.
+
+Every point of the search space is run through replay_bin on each stream,
+JOBS at a time. Successive halving keeps the sweep cheap: all points first
+run a short simulation, only the best 1/ETA survive to a run ETA times
+longer, and so on until the survivors run the full --sim length. Each point
+checkpoints its warmup on the first rung and restores it on later ones.
+
+    ./sweep.py --grid rrpv_bits=2,3 --grid shct_size=1024,4096,16384 \\
+        --grid threshold=2:5 --warmup 200000000 --sim 1000000000 results/*.llc.gz
+
+--grid key=v1,v2,... or key=lo:hi (inclusive) adds a dimension; the keys are
+the policy's runtime parameters (see README). --random N samples N points of
+the grid instead of running all of it. The ranked table is printed and
+written to --out as CSV.
+"""
+
+import argparse
+import concurrent.futures
+import csv
+import itertools
+import math
+import os
+import random
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+MPKI_RE = re.compile(r"LLC MPKI\s*:\s*([0-9.eE+-]+)")
+
+
+def parse_values(spec):
+    if ":" in spec:
+        lo, hi = spec.split(":", 1)
+        return [str(v) for v in range(int(lo, 0), int(hi, 0) + 1)]
+    return [v.strip() for v in spec.split(",") if v.strip()]
+
+
+def build_points(args):
+    keys, values = [], []
+    for g in args.grid:
+        if "=" not in g:
+            sys.exit("sweep: expected --grid key=values, got " + g)
+        key, spec = g.split("=", 1)
+        keys.append(key.strip())
+        values.append(parse_values(spec))
+    points = [dict(zip(keys, combo)) for combo in itertools.product(*values)]
+    if args.random and args.random < len(points):
+        points = random.Random(args.seed).sample(points, args.random)
+    return points
+
+
+def label(point):
+    return " ".join("%s=%s" % kv for kv in sorted(point.items())) or "(defaults)"
+
+
+def run_point(args, point, stream, sim, ckpt, first):
+    """Replay one stream for one point; returns its MPKI or None on failure."""
+    cmd = [args.replay, "--warmup_instructions", str(args.warmup),
+           "--simulation_instructions", str(sim)]
+    for kv in args.set + ["%s=%s" % kv for kv in sorted(point.items())]:
+        cmd += ["--set", kv]
+    cmd += ["--checkpoint_out" if first else "--checkpoint_in", ckpt, stream]
+    res = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT,
+                         universal_newlines=True)
+    m = MPKI_RE.search(res.stdout)
+    if res.returncode != 0 or not m:
+        sys.stderr.write("sweep: failed: %s\n%s" % (" ".join(cmd), res.stdout[-2000:]))
+        return None
+    return float(m.group(1))
+
+
+def main():
+    ap = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("streams", nargs="+", help="LLC access streams (.llc.gz)")
+    ap.add_argument("--grid", action="append", default=[], metavar="KEY=VALUES")
+    ap.add_argument("--set", action="append", default=[], metavar="KEY=VALUE",
+                    help="parameter applied to every point")
+    ap.add_argument("--random", type=int, default=0, metavar="N",
+                    help="sample N points of the grid")
+    ap.add_argument("--seed", type=int, default=1)
+    ap.add_argument("--warmup", type=int, default=200000000)
+    ap.add_argument("--sim", type=int, default=1000000000)
+    ap.add_argument("--eta", type=int, default=3, help="halving factor")
+    ap.add_argument("--rungs", type=int, default=3,
+                    help="successive-halving rungs (1: run every point in full)")
+    ap.add_argument("--jobs", type=int, default=os.cpu_count() or 1)
+    ap.add_argument("--replay", default="./replay_bin")
+    ap.add_argument("--out", default="results/sweep.csv")
+    args = ap.parse_args()
+    if args.eta < 2 or args.rungs < 1:
+        sys.exit("sweep: need --eta >= 2 and --rungs >= 1")
+
+    points = build_points(args)
+    # Per point: mean MPKI over the streams and the sim length it came from
+    score = [None] * len(points)
+    reached = [0] * len(points)
+    alive = list(range(len(points)))
+    ckpt_dir = tempfile.mkdtemp(prefix="sweep-ckpt-")
+
+    try:
+        with concurrent.futures.ThreadPoolExecutor(args.jobs) as pool:
+            for rung in range(args.rungs):
+                sim = max(1, args.sim // args.eta ** (args.rungs - 1 - rung))
+                print("rung %d: %d points x %d streams, %d instructions"
+                      % (rung, len(alive), len(args.streams), sim), flush=True)
+                futures = {}
+                for p in alive:
+                    for s, stream in enumerate(args.streams):
+                        ckpt = os.path.join(ckpt_dir, "%d.%d.ckpt" % (p, s))
+                        f = pool.submit(run_point, args, points[p], stream, sim,
+                                        ckpt, rung == 0)
+                        futures[f] = p
+                results = {p: [] for p in alive}
+                for f in concurrent.futures.as_completed(futures):
+                    results[futures[f]].append(f.result())
+                for p in alive:
+                    mpkis = results[p]
+                    score[p] = None if None in mpkis else sum(mpkis) / len(mpkis)
+                    reached[p] = sim
+
+                alive = [p for p in alive if score[p] is not None]
+                alive.sort(key=lambda p: score[p])
+                if rung + 1 < args.rungs:
+                    alive = alive[:max(1, int(math.ceil(len(alive) / float(args.eta))))]
+    finally:
+        shutil.rmtree(ckpt_dir, ignore_errors=True)
+
+    # Deepest rung first, then lowest MPKI; failed points last
+    order = sorted(range(len(points)),
+                   key=lambda p: (score[p] is None, -reached[p],
+                                  score[p] if score[p] is not None else 0))
+    os.makedirs(os.path.dirname(args.out) or ".", exist_ok=True)
+    with open(args.out, "w", newline="") as out:
+        w = csv.writer(out)
+        w.writerow(["rank", "mpki", "sim_instructions", "config"])
+        print("%4s %10s %14s  %s" % ("rank", "mpki", "sim_instr", "config"))
+        for rank, p in enumerate(order, 1):
+            mpki = "failed" if score[p] is None else "%.4f" % score[p]
+            w.writerow([rank, mpki, reached[p], label(points[p])])
+            print("%4d %10s %14d  %s" % (rank, mpki, reached[p], label(points[p])))
+    print("Ranked results in " + args.out)
+
+
+if __name__ == "__main__":
+    main()